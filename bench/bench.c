@@ -0,0 +1,266 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// Replay benchmark of the parser, without SDL: synthetic streams shaped like
+// common terminal traffic are fed through ozterm_have_read_from_master in
+// pty-sized chunks, with counting render callbacks installed.
+//
+//   ozterm-bench [-s megabytes] [-r runs] [-b chunk_size] [-w workload] [-t] [file...]
+//
+// -t also times every chunk and callback (ozterm_set_timing) and prints their
+// percentiles on a second line; that slows the run, so MB/s is not comparable then.
+//
+// Every workload prints one line of key=value pairs, the best of -r runs, so
+// results of two builds can be compared line by line. Files given after the
+// options are replayed instead of the built in workloads; for session recordings
+// (OZTERM_RECORD) that is what the session read from master.
+//
+// The terminal runs on the tracking allocator: terminal_bytes is its peak footprint
+// and parse_allocations what the replay itself allocated, which should stay 0.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ozterm.h"
+#include "workloads.h"
+
+#define DEFAULT_SIZE_MB 16
+#define DEFAULT_RUNS 3
+#define DEFAULT_CHUNK_SIZE 4096
+
+typedef struct Counters
+{
+    uint64_t refresh;
+    uint64_t set_character;
+    uint64_t move_cursor;
+    uint64_t scroll;
+    uint64_t write_to_master;
+} Counters;
+
+static Counters g_counters;
+static OztermStats g_stats;
+static uint8_t g_have_stats;
+static uint8_t g_timing_enabled;
+static OztermTiming g_timing;
+static OztermAllocationStats g_memory;
+static uint64_t g_parse_allocations;
+
+static void count_refresh(Ozterm* terminal)
+{
+    g_counters.refresh++;
+}
+
+static void count_set_character(Ozterm* terminal, int16_t row, int16_t column, OztermCell* cell)
+{
+    g_counters.set_character++;
+}
+
+static void count_move_cursor(Ozterm* terminal, int16_t old_row, int16_t old_column, int16_t row, int16_t column)
+{
+    g_counters.move_cursor++;
+}
+
+static void count_scroll(Ozterm* terminal, int16_t top, int16_t bottom, int16_t lines)
+{
+    g_counters.scroll++;
+}
+
+static void count_write_to_master(Ozterm* terminal, const uint8_t* data, int32_t size)
+{
+    g_counters.write_to_master++;
+}
+
+static uint64_t now_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t replay(const Buffer* buffer, int32_t chunk_size)
+{
+    OztermAllocator allocator;
+    ozterm_tracking_allocator_init(&allocator, &g_memory);
+
+    Ozterm* terminal = ozterm_create_with_allocator(BENCH_ROWS, BENCH_COLUMNS, &allocator);
+    ozterm_set_render_callbacks(terminal, count_refresh, count_set_character, count_move_cursor);
+    ozterm_set_scroll_callback(terminal, count_scroll);
+    ozterm_set_write_to_master_callback(terminal, count_write_to_master);
+    ozterm_set_timing(terminal, g_timing_enabled);
+
+    memset(&g_counters, 0, sizeof(g_counters));
+    uint64_t allocations = g_memory.allocations;
+
+    uint64_t start = now_nanoseconds();
+    for (size_t offset = 0; offset < buffer->size; offset += chunk_size)
+    {
+        size_t size = buffer->size - offset;
+        if (size > (size_t)chunk_size)
+            size = chunk_size;
+
+        ozterm_have_read_from_master(terminal, buffer->data + offset, (int32_t)size);
+    }
+    uint64_t elapsed = now_nanoseconds() - start;
+
+    // Parsing is meant to allocate nothing
+    g_parse_allocations = g_memory.allocations - allocations;
+
+    g_have_stats = ozterm_get_stats(terminal, &g_stats);
+    ozterm_get_timing(terminal, &g_timing);
+
+    ozterm_destroy(terminal);
+
+    return elapsed;
+}
+
+static void run(const char* name, const Buffer* buffer, int runs, int32_t chunk_size)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < runs; ++i)
+    {
+        uint64_t elapsed = replay(buffer, chunk_size);
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    if (best == 0)
+        best = 1;
+
+    printf("workload=%s bytes=%zu runs=%d mb_per_s=%.1f ns_per_byte=%.2f"
+           " refresh=%llu set_character=%llu move_cursor=%llu scroll=%llu write_to_master=%llu"
+           " terminal_bytes=%llu parse_allocations=%llu\n",
+           name, buffer->size, runs,
+           buffer->size / 1e6 / (best / 1e9), (double)best / buffer->size,
+           (unsigned long long)g_counters.refresh, (unsigned long long)g_counters.set_character,
+           (unsigned long long)g_counters.move_cursor, (unsigned long long)g_counters.scroll,
+           (unsigned long long)g_counters.write_to_master,
+           (unsigned long long)g_memory.peak_bytes, (unsigned long long)g_parse_allocations);
+
+    if (g_timing_enabled)
+    {
+        uint64_t callback_total = 0;
+        for (int i = 0; i < OZTERM_CALLBACK_COUNT; ++i)
+        {
+            callback_total += g_timing.callbacks[i].total;
+        }
+
+        const OztermHistogram* chunk = &g_timing.chunk;
+        printf("workload=%s chunk_p50_us=%.1f chunk_p99_us=%.1f chunk_max_us=%.1f callback_pct=%.1f"
+               " set_character_p99_ns=%llu move_cursor_p99_ns=%llu scroll_p99_ns=%llu\n",
+               name, ozterm_histogram_percentile(chunk, 50) / 1e3, ozterm_histogram_percentile(chunk, 99) / 1e3,
+               chunk->max / 1e3, chunk->total ? 100.0 * callback_total / chunk->total : 0.0,
+               (unsigned long long)ozterm_histogram_percentile(&g_timing.callbacks[OZTERM_CALLBACK_SET_CHARACTER], 99),
+               (unsigned long long)ozterm_histogram_percentile(&g_timing.callbacks[OZTERM_CALLBACK_MOVE_CURSOR], 99),
+               (unsigned long long)ozterm_histogram_percentile(&g_timing.callbacks[OZTERM_CALLBACK_SCROLL], 99));
+    }
+
+    // Built with make STATS=1
+    if (g_have_stats)
+    {
+        uint64_t csi = 0, esc = 0;
+        for (int i = 0; i < 128; ++i)
+        {
+            csi += g_stats.csi[i];
+            esc += g_stats.esc[i];
+        }
+
+        printf("workload=%s printable_bytes=%llu control_bytes=%llu csi=%llu esc=%llu osc=%llu unhandled=%llu"
+               " scrolls=%llu scrolled_lines=%llu scrollback_pushes=%llu cells_written=%llu\n",
+               name, (unsigned long long)g_stats.printable_bytes, (unsigned long long)g_stats.control_bytes,
+               (unsigned long long)csi, (unsigned long long)esc, (unsigned long long)g_stats.osc,
+               (unsigned long long)g_stats.unhandled, (unsigned long long)g_stats.scrolls,
+               (unsigned long long)g_stats.scrolled_lines, (unsigned long long)g_stats.scrollback_pushes,
+               (unsigned long long)g_stats.cells_written);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = (size_t)DEFAULT_SIZE_MB << 20;
+    int runs = DEFAULT_RUNS;
+    int32_t chunk_size = DEFAULT_CHUNK_SIZE;
+    const char* only = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:r:b:w:th")) != -1)
+    {
+        switch (option)
+        {
+            case 's': size = (size_t)atoi(optarg) << 20; break;
+            case 'r': runs = atoi(optarg); break;
+            case 'b': chunk_size = atoi(optarg); break;
+            case 'w': only = optarg; break;
+            case 't': g_timing_enabled = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-s megabytes] [-r runs] [-b chunk_size] [-w workload] [-t] [file...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (size == 0 || runs <= 0 || chunk_size <= 0)
+    {
+        fprintf(stderr, "%s: sizes and runs must be positive\n", argv[0]);
+        return 1;
+    }
+
+    // Files replace the built in workloads
+    if (optind < argc)
+    {
+        for (int i = optind; i < argc; ++i)
+        {
+            Buffer buffer = { NULL, 0, 0 };
+            if (buffer_load_file(argv[i], &buffer) && buffer.size > 0)
+            {
+                const char* name = strrchr(argv[i], '/');
+                run(name ? name + 1 : argv[i], &buffer, runs, chunk_size);
+            }
+            free(buffer.data);
+        }
+        return 0;
+    }
+
+    const Workload* workload;
+    for (int i = 0; (workload = workload_at(i)) != NULL; ++i)
+    {
+        if (only && strcmp(only, workload->name) != 0)
+            continue;
+
+        Buffer buffer = { NULL, 0, 0 };
+        workload_generate(workload, &buffer, size);
+        run(workload->name, &buffer, runs, chunk_size);
+        free(buffer.data);
+    }
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#!/bin/sh
+# epoll against io_uring in the headless server: system calls per MB parsed and
+# the time from a session being reported ready to its data being parsed.
+#
+# Usage: bench/headless_backends.sh [sessions] [size_mb_per_session] [workers]
+
+SESSIONS=${1:-64}
+SIZE_MB=${2:-4}
+WORKERS=${3:-0}
+WORKLOAD=/tmp/ozterm-backends-$$.txt
+SOCKET=/tmp/ozterm-backends-$$.sock
+
+cd "$(dirname "$0")/.." || exit 1
+make -s headless || exit 1
+
+head -c $((SIZE_MB * 1024 * 1024 * 3 / 4)) /dev/urandom | base64 > "$WORKLOAD"
+
+for backend in "" "-u"; do
+    ./ozterm-headless -e $backend -j "$WORKERS" -n "$SESSIONS" -s "$SOCKET" cat "$WORKLOAD" | tail -n 1
+done
+
+rm -f "$WORKLOAD"
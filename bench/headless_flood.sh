@@ -0,0 +1,40 @@
+#!/bin/sh
+# Aggregate parse throughput of the headless server with every session flooding
+# at once, for a growing number of pool workers.
+#
+# Usage: bench/headless_flood.sh [sessions] [size_mb_per_session]
+#
+# workers=0 parses on the epoll thread. Run it on an otherwise idle machine;
+# the children's cat competes for the same cores.
+
+SESSIONS=${1:-16}
+SIZE_MB=${2:-16}
+WORKLOAD=/tmp/ozterm-flood-$$.txt
+SOCKET=/tmp/ozterm-flood-$$.sock
+
+cd "$(dirname "$0")/.." || exit 1
+make -s headless || exit 1
+
+# Colored log-like lines, about 100 bytes each
+awk -v bytes=$((SIZE_MB * 1024 * 1024)) 'BEGIN {
+    while (total < bytes) {
+        line = sprintf("\033[3%dm%06d\033[0m the quick brown fox jumps over the lazy dog \033[1mstatus=%d\033[0m", n % 8, n, n % 200)
+        print line
+        total += length(line) + 1
+        n++
+    }
+}' > "$WORKLOAD"
+
+CPUS=$(getconf _NPROCESSORS_ONLN)
+WORKERS="0 1"
+w=2
+while [ $w -le "$CPUS" ]; do
+    WORKERS="$WORKERS $w"
+    w=$((w * 2))
+done
+
+for j in $WORKERS; do
+    ./ozterm-headless -e -j "$j" -n "$SESSIONS" -s "$SOCKET" cat "$WORKLOAD" | tail -n 1
+done
+
+rm -f "$WORKLOAD"
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Per-session CPU and memory overhead of the headless server.
+#
+# Usage: bench/headless_sessions.sh [sessions] [seconds]
+#
+# Every session runs a shell printing a line per second, so the server sees
+# steady light traffic. Only the server process is measured, not the children.
+
+SESSIONS=${1:-1000}
+DURATION=${2:-10}
+SOCKET=/tmp/ozterm-bench-$$.sock
+
+cd "$(dirname "$0")/.." || exit 1
+make -s headless || exit 1
+
+./ozterm-headless -n "$SESSIONS" -s "$SOCKET" sh -c 'while :; do echo tick; sleep 1; done' > /dev/null &
+SERVER=$!
+
+# Ready once every session is listed
+while ! ./ozterm-headless -x "$SOCKET" list 2> /dev/null | wc -l | grep -qx "$SESSIONS"; do
+    sleep 0.2
+done
+
+ticks() { awk '{ print $14 + $15 }' "/proc/$SERVER/stat"; }
+HZ=$(getconf CLK_TCK)
+
+START=$(ticks)
+sleep "$DURATION"
+END=$(ticks)
+
+RSS_KB=$(awk '/^VmRSS/ { print $2 }' "/proc/$SERVER/status")
+
+./ozterm-headless -x "$SOCKET" stats
+./ozterm-headless -x "$SOCKET" quit > /dev/null
+wait "$SERVER"
+
+awk -v n="$SESSIONS" -v rss="$RSS_KB" -v t=$((END - START)) -v hz="$HZ" -v d="$DURATION" 'BEGIN {
+    cpu = 100 * t / hz / d
+    printf "sessions=%d rss_kb=%d rss_per_session_kb=%.1f cpu_pct=%.2f cpu_pct_per_session=%.4f\n", n, rss, rss / n, cpu, cpu / n
+}'
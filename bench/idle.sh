@@ -0,0 +1,17 @@
+#!/bin/sh
+# Idle CPU and pty wake-up latency of the SDL demo.
+#
+# Usage: bench/idle.sh [seconds]
+#
+# Run it under a real display (or xvfb-run). SDL's dummy video driver has no
+# blocking wait and polls every millisecond, which hides the idle cost.
+
+DURATION=${1:-10}
+
+cd "$(dirname "$0")/.." || exit 1
+
+echo "# idle: child sleeps, nothing is drawn"
+OZTERM_STATS=1 ./ozterm sleep "$DURATION"
+
+echo "# wakeups: child prints a line every 100 ms"
+OZTERM_STATS=1 ./ozterm sh -c "i=0; while [ \$i -lt $((DURATION * 10)) ]; do echo tick \$i; sleep 0.1; i=\$((i + 1)); done"
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Key-to-pty latency of the SDL demo while the child floods output.
+#
+# Usage: bench/input_latency.sh [size_mb]
+#
+# A key is injected every 20 ms; the keys= line of the stats reports how long
+# each took from the SDL event to reaching the pty.
+
+SIZE_MB=${1:-256}
+
+cd "$(dirname "$0")/.." || exit 1
+
+OZTERM_STATS=1 OZTERM_INJECT_KEY_MS=20 ./ozterm sh -c "head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom | base64"
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Keypress-to-screen latency of the SDL demo against a raw echoing child.
+#
+# Usage: bench/key_to_screen.sh [probes] [flood_mb]
+#
+# Probe keys are typed one at a time; each is timed from ozterm_send_key to the
+# presented frame that shows its echo. With flood_mb, the child also floods that
+# much base64 output while echoing. Reports p50/p90/p99/max per stage.
+
+PROBES=${1:-200}
+FLOOD_MB=${2:-0}
+
+cd "$(dirname "$0")/.." || exit 1
+
+if [ "$FLOOD_MB" -gt 0 ]; then
+    CHILD="stty raw -echo; head -c $((FLOOD_MB * 1024 * 1024)) /dev/urandom | base64 & exec cat"
+else
+    CHILD="stty raw -echo; exec cat"
+fi
+
+OZTERM_LATENCY_PROBES=$PROBES ./ozterm sh -c "$CHILD"
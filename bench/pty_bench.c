@@ -0,0 +1,325 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// End to end throughput through a real pty: a forked child writes a workload to
+// the slave side while this process drains the master with the demo's read loop
+// (poll, read as much as fits, hand it to the terminal) and parses it. Unlike
+// ozterm-bench this includes the syscalls and the kernel's pty buffering. No SDL.
+//
+//   ozterm-ptybench [-s megabytes] [-r runs] [-b read_size] [-w workload] [file...]
+//
+// Every workload prints one line of key=value pairs for the fastest of -r runs:
+// wall time and MB/s, how many reads it took and how big they were, the share of
+// the wall time spent parsing, and user/system CPU of this process and the child.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/param.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include "ozterm.h"
+#include "workloads.h"
+
+#define DEFAULT_SIZE_MB 64
+#define DEFAULT_RUNS 3
+// The demo reads into free ring space, which is up to its whole 1MB ring
+#define DEFAULT_READ_SIZE (1 << 20)
+
+// Read sizes by power of two, the last bucket takes everything bigger
+#define READ_BUCKETS 24
+
+typedef struct Result
+{
+    uint64_t wall;
+    uint64_t parse;
+    uint64_t bytes;
+    uint64_t reads;
+    uint64_t read_max;
+    uint64_t read_buckets[READ_BUCKETS];
+    struct rusage self;
+    struct rusage child;
+} Result;
+
+static int g_master_fd = -1;
+
+static uint64_t now_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double milliseconds(const struct timeval* tv)
+{
+    return tv->tv_sec * 1e3 + tv->tv_usec / 1e3;
+}
+
+// Workloads do not query the terminal, but replies must not be lost if a file does
+static void write_to_master(Ozterm* terminal, const uint8_t* data, int32_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(g_master_fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        data += written;
+        size -= written;
+    }
+}
+
+static void write_all(int fd, const uint8_t* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        data += written;
+        size -= written;
+    }
+}
+
+static int read_bucket(uint64_t size)
+{
+    int bucket = 0;
+    while (bucket < READ_BUCKETS - 1 && ((uint64_t)1 << bucket) < size)
+        bucket++;
+    return bucket;
+}
+
+// Upper bound of the read size below which pct percent of the reads fall
+static uint64_t read_percentile(const Result* result, int pct)
+{
+    uint64_t target = (result->reads * pct + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < READ_BUCKETS; ++i)
+    {
+        seen += result->read_buckets[i];
+        if (seen >= target && seen > 0)
+            return i == READ_BUCKETS - 1 ? result->read_max : MIN((uint64_t)1 << i, result->read_max);
+    }
+    return result->read_max;
+}
+
+static int replay(const Buffer* buffer, size_t read_size, uint8_t* data, Result* result)
+{
+    memset(result, 0, sizeof(*result));
+
+    // Raw, so the bytes arrive as written and can be counted
+    struct termios tio;
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    struct winsize ws = { .ws_row = BENCH_ROWS, .ws_col = BENCH_COLUMNS };
+
+    uint64_t start = now_nanoseconds();
+
+    pid_t pid = forkpty(&g_master_fd, NULL, &tio, &ws);
+    if (pid < 0)
+    {
+        perror("forkpty");
+        return 0;
+    }
+
+    if (pid == 0)
+    {
+        write_all(STDOUT_FILENO, buffer->data, buffer->size);
+        _exit(0);
+    }
+
+    Ozterm* terminal = ozterm_create(BENCH_ROWS, BENCH_COLUMNS);
+    ozterm_set_write_to_master_callback(terminal, write_to_master);
+
+    struct pollfd fds[1] =
+    {
+        { .fd = g_master_fd, .events = POLLIN },
+    };
+
+    while (1)
+    {
+        if (poll(fds, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        ssize_t len = read(g_master_fd, data, read_size);
+
+        if (len > 0)
+        {
+            result->bytes += len;
+            result->reads++;
+            result->read_max = MAX(result->read_max, (uint64_t)len);
+            result->read_buckets[read_bucket(len)]++;
+
+            uint64_t parse_start = now_nanoseconds();
+            ozterm_have_read_from_master(terminal, data, (int32_t)len);
+            result->parse += now_nanoseconds() - parse_start;
+        }
+        else if (len < 0 && (errno == EINTR || errno == EAGAIN))
+        {
+            continue;
+        }
+        else
+        {
+            // Child has exited and everything it wrote was read
+            break;
+        }
+    }
+
+    int status;
+    wait4(pid, &status, 0, &result->child);
+    result->wall = now_nanoseconds() - start;
+
+    ozterm_destroy(terminal);
+    close(g_master_fd);
+    g_master_fd = -1;
+
+    return 1;
+}
+
+static void run(const char* name, const Buffer* buffer, int runs, size_t read_size)
+{
+    uint8_t* data = malloc(read_size);
+    Result best;
+    best.wall = UINT64_MAX;
+
+    for (int i = 0; i < runs; ++i)
+    {
+        struct rusage before, after;
+        getrusage(RUSAGE_SELF, &before);
+
+        Result result;
+        if (!replay(buffer, read_size, data, &result))
+            break;
+
+        getrusage(RUSAGE_SELF, &after);
+        timersub(&after.ru_utime, &before.ru_utime, &result.self.ru_utime);
+        timersub(&after.ru_stime, &before.ru_stime, &result.self.ru_stime);
+
+        if (result.wall < best.wall)
+            best = result;
+    }
+    free(data);
+
+    if (best.wall == UINT64_MAX)
+        return;
+
+    if (best.bytes != buffer->size)
+        fprintf(stderr, "%s: read %llu bytes of %zu\n", name, (unsigned long long)best.bytes, buffer->size);
+
+    printf("workload=%s bytes=%llu runs=%d wall_ms=%.1f mb_per_s=%.1f"
+           " reads=%llu read_avg=%llu read_p50=%llu read_p99=%llu read_max=%llu parse_pct=%.1f"
+           " user_ms=%.1f sys_ms=%.1f child_user_ms=%.1f child_sys_ms=%.1f\n",
+           name, (unsigned long long)best.bytes, runs, best.wall / 1e6, best.bytes / 1e6 / (best.wall / 1e9),
+           (unsigned long long)best.reads, (unsigned long long)(best.reads ? best.bytes / best.reads : 0),
+           (unsigned long long)read_percentile(&best, 50), (unsigned long long)read_percentile(&best, 99),
+           (unsigned long long)best.read_max, 100.0 * best.parse / best.wall,
+           milliseconds(&best.self.ru_utime), milliseconds(&best.self.ru_stime),
+           milliseconds(&best.child.ru_utime), milliseconds(&best.child.ru_stime));
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = (size_t)DEFAULT_SIZE_MB << 20;
+    int runs = DEFAULT_RUNS;
+    size_t read_size = DEFAULT_READ_SIZE;
+    const char* only = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:r:b:w:h")) != -1)
+    {
+        switch (option)
+        {
+            case 's': size = (size_t)atoi(optarg) << 20; break;
+            case 'r': runs = atoi(optarg); break;
+            case 'b': read_size = (size_t)atoi(optarg); break;
+            case 'w': only = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-s megabytes] [-r runs] [-b read_size] [-w workload] [file...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (size == 0 || runs <= 0 || read_size == 0 || read_size > INT32_MAX)
+    {
+        fprintf(stderr, "%s: sizes and runs must be positive\n", argv[0]);
+        return 1;
+    }
+
+    // Files replace the built in workloads
+    if (optind < argc)
+    {
+        for (int i = optind; i < argc; ++i)
+        {
+            Buffer buffer = { NULL, 0, 0 };
+            if (buffer_load_file(argv[i], &buffer) && buffer.size > 0)
+            {
+                const char* name = strrchr(argv[i], '/');
+                run(name ? name + 1 : argv[i], &buffer, runs, read_size);
+            }
+            free(buffer.data);
+        }
+        return 0;
+    }
+
+    const Workload* workload;
+    for (int i = 0; (workload = workload_at(i)) != NULL; ++i)
+    {
+        if (only && strcmp(only, workload->name) != 0)
+            continue;
+
+        Buffer buffer = { NULL, 0, 0 };
+        workload_generate(workload, &buffer, size);
+        run(workload->name, &buffer, runs, read_size);
+        free(buffer.data);
+    }
+
+    return 0;
+}
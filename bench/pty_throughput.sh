@@ -0,0 +1,25 @@
+#!/bin/sh
+# Pty throughput of the SDL demo: how long the child is stalled writing
+# a large file into the terminal.
+#
+# Usage: bench/pty_throughput.sh [megabytes]
+#
+# The child times its own cat, so the result is the time it spent blocked
+# on the pty, i.e. how fast the terminal drains it. Run once per build to
+# compare loops.
+
+SIZE_MB=${1:-64}
+
+cd "$(dirname "$0")/.." || exit 1
+
+DATA=$(mktemp)
+RESULT=$(mktemp)
+trap 'rm -f "$DATA" "$RESULT"' EXIT
+
+# plain log-like lines
+yes "ozterm pty throughput benchmark line: the quick brown fox jumps over the lazy dog" | head -c $((SIZE_MB * 1024 * 1024)) > "$DATA"
+
+OZTERM_STATS=1 ./ozterm sh -c "start=\$(date +%s%N); cat '$DATA'; end=\$(date +%s%N); echo \$((end - start)) > '$RESULT'"
+
+NS=$(cat "$RESULT")
+awk -v ns="$NS" -v mb="$SIZE_MB" 'BEGIN { printf "size_mb=%d child_stall_ms=%.1f mb_per_s=%.1f\n", mb, ns / 1e6, mb / (ns / 1e9) }'
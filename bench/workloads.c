@@ -0,0 +1,256 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// Synthetic terminal traffic shared by the benchmarks, and loading of captured
+// streams and session recordings to replay instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ozterm.h"
+#include "recorder.h"
+#include "workloads.h"
+
+static uint32_t g_random = 2463534242u;
+
+static uint32_t next_random()
+{
+    g_random ^= g_random << 13;
+    g_random ^= g_random >> 17;
+    g_random ^= g_random << 5;
+    return g_random;
+}
+
+void buffer_append(Buffer* buffer, const void* data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = (buffer->size + size) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void append_format(Buffer* buffer, const char* format, int a, int b)
+{
+    char text[64];
+    int length = snprintf(text, sizeof(text), format, a, b);
+    buffer_append(buffer, text, length);
+}
+
+static void append_word(Buffer* buffer)
+{
+    static const char* words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "ozterm",
+        "request", "completed", "in", "ms", "status=200", "GET", "/index.html", "warning:"
+    };
+
+    const char* word = words[next_random() % (sizeof(words) / sizeof(words[0]))];
+    buffer_append(buffer, word, strlen(word));
+}
+
+// Log output: lines of words, scrolling the whole screen
+static void generate_ascii(Buffer* buffer, size_t size)
+{
+    while (buffer->size < size)
+    {
+        int words = 4 + next_random() % 10;
+        for (int i = 0; i < words; ++i)
+        {
+            append_word(buffer);
+            buffer_append(buffer, " ", 1);
+        }
+        buffer_append(buffer, "\r\n", 2);
+    }
+}
+
+// Colored compiler or ls output: an SGR change around nearly every word
+static void generate_sgr(Buffer* buffer, size_t size)
+{
+    while (buffer->size < size)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            switch (next_random() % 4)
+            {
+                case 0: append_format(buffer, "\033[%d;%dm", 40 + next_random() % 8, 90 + next_random() % 8); break;
+                case 1: append_format(buffer, "\033[38;5;%dm\033[48;5;%dm", next_random() % 256, next_random() % 256); break;
+                case 2: append_format(buffer, "\033[38;2;%d;%d;128m", next_random() % 256, next_random() % 256); break;
+                default: buffer_append(buffer, "\033[7m", 4); break;
+            }
+            append_word(buffer);
+            buffer_append(buffer, "\033[0m ", 5);
+        }
+        buffer_append(buffer, "\r\n", 2);
+    }
+}
+
+// Full screen TUI redraws: cursor positioning, line erases and short runs of text
+static void generate_cursor(Buffer* buffer, size_t size)
+{
+    while (buffer->size < size)
+    {
+        buffer_append(buffer, "\033[?25l", 6);
+        for (int i = 0; i < 40; ++i)
+        {
+            append_format(buffer, "\033[%d;%dH", 1 + next_random() % BENCH_ROWS, 1 + next_random() % BENCH_COLUMNS);
+            if (next_random() % 4 == 0)
+                buffer_append(buffer, "\033[K", 3);
+            append_word(buffer);
+            if (next_random() % 2)
+                append_format(buffer, "\033[%dC\033[%dA", 1 + next_random() % 4, next_random() % 3);
+        }
+        append_format(buffer, "\033[%d;%dH\033[?25h", BENCH_ROWS, 1);
+    }
+}
+
+// Pager or editor scrolling inside a region: DECSTBM, then index and reverse index
+static void generate_scroll_region(Buffer* buffer, size_t size)
+{
+    while (buffer->size < size)
+    {
+        int top = 2 + next_random() % 4;
+        int bottom = BENCH_ROWS - 1 - next_random() % 4;
+        append_format(buffer, "\033[%d;%dr", top, bottom);
+
+        for (int i = 0; i < 50; ++i)
+        {
+            if (next_random() % 4 == 0)
+            {
+                append_format(buffer, "\033[%d;%dH\033M", top, 1);
+            }
+            else
+            {
+                append_format(buffer, "\033[%d;%dH\n", bottom, 1);
+            }
+            append_word(buffer);
+            buffer_append(buffer, " ", 1);
+            append_word(buffer);
+
+            if (next_random() % 8 == 0)
+                append_format(buffer, "\033[%dL\033[%dM", 1 + next_random() % 3, 1 + next_random() % 3);
+        }
+        buffer_append(buffer, "\033[r", 3);
+    }
+}
+
+// Full screen programs starting and exiting: alternate screen switches with a redraw between
+static void generate_alt_screen(Buffer* buffer, size_t size)
+{
+    while (buffer->size < size)
+    {
+        buffer_append(buffer, "\033[?1049h\033[H\033[2J", 16);
+        for (int row = 1; row <= BENCH_ROWS; ++row)
+        {
+            append_format(buffer, "\033[%d;%dH", row, 1);
+            for (int i = 0; i < 6; ++i)
+            {
+                append_word(buffer);
+                buffer_append(buffer, " ", 1);
+            }
+        }
+        buffer_append(buffer, "\033[?1049l", 8);
+        append_word(buffer);
+        buffer_append(buffer, "\r\n", 2);
+    }
+}
+
+// Non English text: two, three and four byte UTF-8 sequences between ASCII
+static void generate_utf8(Buffer* buffer, size_t size)
+{
+    static const char* words[] = {
+        "größe", "Привет", "日本語の", "テキスト", "κόσμος", "😀", "ünïcödé", "€", "中文", "ascii"
+    };
+
+    while (buffer->size < size)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            const char* word = words[next_random() % (sizeof(words) / sizeof(words[0]))];
+            buffer_append(buffer, word, strlen(word));
+            buffer_append(buffer, " ", 1);
+        }
+        buffer_append(buffer, "\r\n", 2);
+    }
+}
+
+static const Workload g_workloads[] = {
+    { "ascii", generate_ascii },
+    { "sgr", generate_sgr },
+    { "cursor", generate_cursor },
+    { "scroll_region", generate_scroll_region },
+    { "alt_screen", generate_alt_screen },
+    { "utf8", generate_utf8 },
+};
+
+const Workload* workload_at(int index)
+{
+    if (index < 0 || index >= (int)(sizeof(g_workloads) / sizeof(g_workloads[0])))
+        return NULL;
+    return &g_workloads[index];
+}
+
+void workload_generate(const Workload* workload, Buffer* buffer, size_t size)
+{
+    // Same seed for every workload, so the streams do not depend on which ones run
+    g_random = 2463534242u;
+    workload->generate(buffer, size);
+}
+
+int buffer_load_file(const char* path, Buffer* buffer)
+{
+    size_t size;
+    uint8_t* data = recorder_load_file(path, &size);
+    if (!data)
+    {
+        perror(path);
+        return 0;
+    }
+
+    if (recorder_is_recording(data, size))
+    {
+        const uint8_t* cursor = data + RECORDER_HEADER_SIZE;
+        RecorderRecord record;
+        while (recorder_next_record(&cursor, data + size, &record) > 0)
+        {
+            if (record.direction == OZTERM_RECORD_OUTPUT)
+                buffer_append(buffer, record.data, record.size);
+        }
+    }
+    else
+    {
+        buffer_append(buffer, data, size);
+    }
+
+    free(data);
+    return 1;
+}
@@ -0,0 +1,66 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Screen size the workloads are generated for
+#define BENCH_ROWS 25
+#define BENCH_COLUMNS 80
+
+typedef struct Buffer
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef void (*Generator)(Buffer* buffer, size_t size);
+
+typedef struct Workload
+{
+    const char* name;
+    Generator generate;
+} Workload;
+
+void buffer_append(Buffer* buffer, const void* data, size_t size);
+
+//reads a whole file, a session recording (OZTERM_RECORD) becomes what the session read from master
+int buffer_load_file(const char* path, Buffer* buffer);
+
+//NULL past the last workload
+const Workload* workload_at(int index);
+
+//appends at least size bytes; the stream is the same on every call
+void workload_generate(const Workload* workload, Buffer* buffer, size_t size);
+
+#endif // WORKLOADS_H
@@ -0,0 +1,1231 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// Headless multi-session server: runs many terminals without a window, for
+// driving and scraping TUIs in automated tests. Linux only (epoll).
+//
+//   ozterm-headless [-n sessions] [-j workers] [-e] [-s socket] [-r rows] [-c columns] [command [args...]]
+//   ozterm-headless -x socket request...
+//
+// One thread waits on all fds. Ready sessions are parsed on a work-stealing pool
+// of -j workers (default: one per CPU, 0 parses on the waiting thread). A session
+// is armed with EPOLLONESHOT and only re-armed by the task that served it, so it is
+// never on two workers at once. -e exits once every session has ended and prints
+// the throughput, for benchmarks.
+//
+// -u moves session I/O to io_uring where the kernel has it: reads complete into
+// registered per-session buffers that are parsed in place, and the reads and writes
+// of all sessions are submitted in one batch per loop. The ring's fd waits in the
+// same epoll set as the control socket. Without io_uring this falls back to epoll.
+//
+// Requests on the control socket are single lines:
+//   list                  one line per session: id pid alive cursor_row cursor_column
+//   screen ID             the rows of a session, trailing blanks trimmed
+//   send ID TEXT          types TEXT, \n \r \t \e \\ and \xHH are unescaped
+//   paste ID TEXT         same, as a paste
+//   key ID NAME           up down left right home end pageup pagedown insert
+//                         delete enter backspace tab escape f1..f12
+//   stats                 totals for the whole server
+//   quit                  ends all sessions and the server
+// Each reply starts with "ok COUNT" followed by COUNT lines, or is one "error ..." line.
+
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ozterm.h"
+#include "queue.h"
+#include "pool.h"
+#include "uring.h"
+
+#define DEFAULT_ROWS 24
+#define DEFAULT_COLUMNS 80
+#define DEFAULT_SOCKET "/tmp/ozterm-headless.sock"
+
+// A few reads per turn, so a flooding session cannot starve the others
+#define READ_BUFFER_SIZE (64 * 1024)
+#define READS_PER_TURN 4
+#define MAX_EVENTS 256
+#define OUTPUT_QUEUE_SIZE 256
+#define REQUEST_LINE_MAX 65536
+
+// Unhandled escape sequences are only counted, collected this often
+#define UNHANDLED_REPORT_MS 1000
+
+// Registered read buffer of each session with io_uring
+#define URING_BUFFER_SIZE (16 * 1024)
+// Copy of the output being written: the queue may grow and move while the kernel reads
+#define URING_WRITE_SIZE 4096
+#define URING_SESSION_MEMORY (URING_BUFFER_SIZE + URING_WRITE_SIZE)
+#define URING_MAX_ENTRIES 32768
+
+// What a session asks the io_uring loop to submit for it
+#define REQUEST_READ 1
+#define REQUEST_WRITE 2
+
+// Low bit of a completion's user_data, the rest is the session
+#define URING_OP_WRITE 1
+
+typedef enum EndpointKind
+{
+    ENDPOINT_LISTEN,
+    ENDPOINT_WAKE,
+    ENDPOINT_URING,
+    ENDPOINT_SESSION,
+    ENDPOINT_CLIENT
+} EndpointKind;
+
+// Anything registered with epoll, with its unwritten output
+typedef struct Endpoint
+{
+    EndpointKind kind;
+    int fd;
+    Queue output;
+    uint8_t polling_out;
+} Endpoint;
+
+// Everything but scheduled is guarded by lock: the serving worker holds it
+// while parsing, control requests take it to look or type
+typedef struct Session
+{
+    Endpoint endpoint;
+    pthread_mutex_t lock;
+    atomic_int scheduled;
+    int id;
+    pid_t pid;
+    uint8_t alive;
+    Ozterm* terminal;
+    // what the terminal allocated, counted by its tracking allocator
+    OztermAllocationStats memory;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t reads;
+    // from being reported ready to being parsed
+    uint64_t ready_time;
+    uint64_t turns;
+    uint64_t latency_total;
+    uint64_t latency_max;
+    uint64_t unhandled;
+    // io_uring: completed bytes waiting in buffer, pending submissions
+    uint8_t* buffer;
+    int32_t buffer_length;
+    uint8_t* write_buffer;
+    uint8_t write_in_flight;
+    uint8_t requests; // guarded by g_requests_lock
+} Session;
+
+typedef struct Client
+{
+    Endpoint endpoint;
+    char line[REQUEST_LINE_MAX];
+    int line_length;
+} Client;
+
+static int g_epoll_fd = -1;
+static Endpoint g_listen = { .kind = ENDPOINT_LISTEN, .fd = -1 };
+static Endpoint g_wake = { .kind = ENDPOINT_WAKE, .fd = -1 };
+static Session* g_sessions = NULL;
+static int g_session_count = 0;
+static int g_running = 1;
+static Pool* g_pool = NULL;
+
+static atomic_int g_alive;
+static int g_exit_when_done = 0;
+static _Atomic uint64_t g_done_time = 0;
+static _Atomic uint64_t g_syscalls = 0;
+
+static Uring* g_uring = NULL;
+static Endpoint g_uring_endpoint = { .kind = ENDPOINT_URING, .fd = -1 };
+static uint8_t* g_uring_buffers = NULL;
+static uint8_t* g_uring_write_buffers = NULL;
+static int g_uring_fixed = 0;
+
+// Sessions waiting for the loop thread to submit their io_uring reads and writes
+static pthread_mutex_t g_requests_lock = PTHREAD_MUTEX_INITIALIZER;
+static Session** g_requests = NULL;
+static Session** g_requests_taken = NULL;
+static int g_request_count = 0;
+static _Thread_local int t_loop_thread = 0;
+static atomic_int g_loop_sleeping;
+
+static void count_syscall()
+{
+    atomic_fetch_add_explicit(&g_syscalls, 1, memory_order_relaxed);
+}
+
+static uint64_t now_microseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void endpoint_update_events(Endpoint* endpoint)
+{
+    uint8_t polling_out = endpoint->output.size > 0;
+    if (polling_out == endpoint->polling_out)
+        return;
+
+    struct epoll_event event = { .events = EPOLLIN | (polling_out ? EPOLLOUT : 0), .data.ptr = endpoint };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, endpoint->fd, &event);
+    endpoint->polling_out = polling_out;
+}
+
+// Writes what the fd takes now, the rest waits for EPOLLOUT
+static uint32_t endpoint_flush(Endpoint* endpoint)
+{
+    const uint8_t* span;
+    uint32_t size;
+    uint32_t total = 0;
+
+    while ((size = queue_peek(&endpoint->output, &span)) > 0)
+    {
+        ssize_t written = write(endpoint->fd, span, size);
+        count_syscall();
+
+        if (written > 0)
+        {
+            queue_pop(&endpoint->output, (uint32_t)written);
+            total += written;
+        }
+        else if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (written < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            // Peer is gone, its hang-up is handled by the read side
+            queue_pop(&endpoint->output, endpoint->output.size);
+        }
+    }
+
+    return total;
+}
+
+static uint32_t endpoint_write(Endpoint* endpoint, const void* data, uint32_t size)
+{
+    if (endpoint->fd < 0 || size == 0)
+        return 0;
+
+    int was_empty = endpoint->output.size == 0;
+    queue_push(&endpoint->output, data, size);
+
+    return was_empty ? endpoint_flush(endpoint) : 0;
+}
+
+static int endpoint_open(Endpoint* endpoint, EndpointKind kind, int fd, uint32_t events)
+{
+    endpoint->kind = kind;
+    endpoint->fd = fd;
+    endpoint->polling_out = 0;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (!queue_init(&endpoint->output, OUTPUT_QUEUE_SIZE))
+        return 0;
+
+    struct epoll_event event = { .events = events, .data.ptr = endpoint };
+    return epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+// The queue storage stays until the owner frees it, an io_uring write may still point into it
+static void endpoint_close(Endpoint* endpoint)
+{
+    if (endpoint->fd < 0)
+        return;
+
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, endpoint->fd, NULL);
+    close(endpoint->fd);
+    endpoint->fd = -1;
+    queue_pop(&endpoint->output, endpoint->output.size);
+}
+
+static void wake_loop()
+{
+    uint64_t one = 1;
+    write(g_wake.fd, &one, sizeof(one));
+    count_syscall();
+}
+
+// Takes the session lock after this one, never the other way round
+static void session_request(Session* session, uint8_t request)
+{
+    pthread_mutex_lock(&g_requests_lock);
+
+    int was_empty = g_request_count == 0;
+    if (!session->requests)
+        g_requests[g_request_count++] = session;
+    session->requests |= request;
+
+    pthread_mutex_unlock(&g_requests_lock);
+
+    // The loop thread submits after every round anyway, it only needs a poke while
+    // blocked. It raises g_loop_sleeping before it last looks at the count.
+    if (was_empty && !t_loop_thread && atomic_load(&g_loop_sleeping))
+        wake_loop();
+}
+
+// With the session lock held. While it is scheduled, the serving task re-arms it.
+static void session_arm(Session* session)
+{
+    if (session->endpoint.fd < 0 || atomic_load(&session->scheduled))
+        return;
+
+    uint32_t events = EPOLLIN | EPOLLONESHOT | (session->endpoint.output.size > 0 ? EPOLLOUT : 0);
+    struct epoll_event event = { .events = events, .data.ptr = session };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, session->endpoint.fd, &event);
+    count_syscall();
+}
+
+// Called with the session locked, while parsing or from print_stats()
+static void session_report_unhandled(Ozterm* terminal, const OztermUnhandled* sequences, int32_t count, uint32_t others)
+{
+    Session* session = ozterm_get_custom_data(terminal);
+
+    session->unhandled += others;
+    for (int32_t i = 0; i < count; ++i)
+    {
+        session->unhandled += sequences[i].count;
+    }
+}
+
+static void session_write_to_master(Ozterm* terminal, const uint8_t* data, int32_t size)
+{
+    Session* session = ozterm_get_custom_data(terminal);
+
+    if (g_uring)
+    {
+        // The master fd blocks in this mode, all writes go through the ring
+        if (session->endpoint.fd >= 0 && size > 0)
+        {
+            queue_push(&session->endpoint.output, data, (uint32_t)size);
+            if (!session->write_in_flight)
+                session_request(session, REQUEST_WRITE);
+        }
+        return;
+    }
+
+    session->bytes_written += endpoint_write(&session->endpoint, data, (uint32_t)size);
+    session_arm(session);
+}
+
+static void session_account_turn(Session* session)
+{
+    uint64_t latency = now_microseconds() - session->ready_time;
+
+    session->turns++;
+    session->latency_total += latency;
+    if (latency > session->latency_max)
+        session->latency_max = latency;
+}
+
+static int session_start(Session* session, int id, int16_t rows, int16_t columns, char** command)
+{
+    struct winsize size = { .ws_row = rows, .ws_col = columns };
+    int master_fd = -1;
+
+    pid_t pid = forkpty(&master_fd, NULL, NULL, &size);
+
+    if (pid < 0)
+        return 0;
+
+    if (pid == 0)
+    {
+        setenv("TERM", "xterm-256color", 1);
+        execvp(command[0], command);
+        _exit(127);
+    }
+
+    session->id = id;
+    session->pid = pid;
+    session->alive = 1;
+    OztermAllocator allocator;
+    ozterm_tracking_allocator_init(&allocator, &session->memory);
+    session->terminal = ozterm_create_with_allocator(rows, columns, &allocator);
+    ozterm_set_custom_data(session->terminal, session);
+    ozterm_set_write_to_master_callback(session->terminal, session_write_to_master);
+    ozterm_set_unhandled_callback(session->terminal, session_report_unhandled, UNHANDLED_REPORT_MS);
+    pthread_mutex_init(&session->lock, NULL);
+    atomic_init(&session->scheduled, 0);
+    atomic_fetch_add(&g_alive, 1);
+
+    if (g_uring)
+    {
+        // Left blocking and out of epoll, io_uring waits for it
+        session->endpoint.kind = ENDPOINT_SESSION;
+        session->endpoint.fd = master_fd;
+        return queue_init(&session->endpoint.output, OUTPUT_QUEUE_SIZE);
+    }
+
+    return endpoint_open(&session->endpoint, ENDPOINT_SESSION, master_fd, EPOLLIN | EPOLLONESHOT);
+}
+
+static void session_exited(Session* session)
+{
+    // EIO once the child closed the slave side. The screen stays readable.
+    session->alive = 0;
+    endpoint_close(&session->endpoint);
+
+    if (atomic_fetch_sub(&g_alive, 1) == 1)
+    {
+        atomic_store(&g_done_time, now_microseconds());
+        wake_loop();
+    }
+}
+
+// One turn of a ready session, on a worker or inline
+static void session_serve(void* data)
+{
+    static _Thread_local uint8_t buffer[READ_BUFFER_SIZE];
+    Session* session = data;
+
+    pthread_mutex_lock(&session->lock);
+
+    if (session->endpoint.output.size > 0)
+        session->bytes_written += endpoint_flush(&session->endpoint);
+
+    for (int i = 0; i < READS_PER_TURN && session->endpoint.fd >= 0; ++i)
+    {
+        ssize_t length = read(session->endpoint.fd, buffer, sizeof(buffer));
+        count_syscall();
+
+        if (length > 0)
+        {
+            ozterm_have_read_from_master(session->terminal, buffer, (int32_t)length);
+            session->bytes_read += length;
+            session->reads++;
+            if (i == 0)
+                session_account_turn(session);
+
+            // A short read drained it, save the EAGAIN round trip
+            if (length < (ssize_t)sizeof(buffer))
+                break;
+        }
+        else if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (length < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            session_exited(session);
+        }
+    }
+
+    atomic_store(&session->scheduled, 0);
+    session_arm(session);
+
+    pthread_mutex_unlock(&session->lock);
+}
+
+// io_uring turn: the completed read is parsed straight from the registered buffer
+static void session_serve_uring(void* data)
+{
+    Session* session = data;
+
+    pthread_mutex_lock(&session->lock);
+
+    ozterm_have_read_from_master(session->terminal, session->buffer, session->buffer_length);
+    session->bytes_read += session->buffer_length;
+    session->reads++;
+    session->buffer_length = 0;
+    session_account_turn(session);
+
+    atomic_store(&session->scheduled, 0);
+
+    pthread_mutex_unlock(&session->lock);
+
+    session_request(session, REQUEST_READ);
+}
+
+static void session_dispatch(Session* session, PoolTask serve)
+{
+    if (atomic_exchange(&session->scheduled, 1))
+        return;
+
+    session->ready_time = now_microseconds();
+
+    if (g_pool)
+        pool_submit(g_pool, serve, session);
+    else
+        serve(session);
+}
+
+// Loop thread: turns the pending requests into one batch of submissions
+static void uring_submit_requests()
+{
+    pthread_mutex_lock(&g_requests_lock);
+    int count = g_request_count;
+    memcpy(g_requests_taken, g_requests, sizeof(Session*) * count);
+    uint8_t requests[count > 0 ? count : 1];
+    for (int i = 0; i < count; ++i)
+    {
+        requests[i] = g_requests[i]->requests;
+        g_requests[i]->requests = 0;
+    }
+    g_request_count = 0;
+    pthread_mutex_unlock(&g_requests_lock);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Session* session = g_requests_taken[i];
+
+        pthread_mutex_lock(&session->lock);
+
+        if (session->endpoint.fd >= 0 && (requests[i] & REQUEST_READ))
+        {
+            uring_prepare_read(g_uring, session->endpoint.fd, session->buffer, URING_BUFFER_SIZE,
+                g_uring_fixed ? session->id : -1, (uint64_t)(uintptr_t)session);
+        }
+
+        if (session->endpoint.fd >= 0 && (requests[i] & REQUEST_WRITE) && !session->write_in_flight)
+        {
+            const uint8_t* span;
+            uint32_t size = queue_peek(&session->endpoint.output, &span);
+            if (size > URING_WRITE_SIZE)
+                size = URING_WRITE_SIZE;
+            if (size > 0)
+            {
+                // The parser keeps pushing while this is in flight, which can move the
+                // queue's storage. The bytes stay queued and are popped on completion.
+                memcpy(session->write_buffer, span, size);
+                uring_prepare_write(g_uring, session->endpoint.fd, session->write_buffer, size,
+                    (uint64_t)(uintptr_t)session | URING_OP_WRITE);
+                session->write_in_flight = 1;
+            }
+        }
+
+        pthread_mutex_unlock(&session->lock);
+    }
+
+    uring_submit(g_uring);
+}
+
+static void uring_complete(void* context, uint64_t user_data, int32_t result)
+{
+    Session* session = (Session*)(uintptr_t)(user_data & ~(uint64_t)URING_OP_WRITE);
+
+    if (user_data & URING_OP_WRITE)
+    {
+        pthread_mutex_lock(&session->lock);
+
+        session->write_in_flight = 0;
+        if (session->endpoint.fd >= 0)
+        {
+            if (result > 0)
+            {
+                queue_pop(&session->endpoint.output, (uint32_t)result);
+                session->bytes_written += result;
+            }
+            else if (result != -EINTR && result != -EAGAIN)
+            {
+                queue_pop(&session->endpoint.output, session->endpoint.output.size);
+            }
+        }
+        int more = session->endpoint.fd >= 0 && session->endpoint.output.size > 0;
+
+        pthread_mutex_unlock(&session->lock);
+
+        if (more)
+            session_request(session, REQUEST_WRITE);
+    }
+    else if (result > 0)
+    {
+        session->buffer_length = result;
+        session_dispatch(session, session_serve_uring);
+    }
+    else if (result == -EINTR || result == -EAGAIN)
+    {
+        session_request(session, REQUEST_READ);
+    }
+    else
+    {
+        pthread_mutex_lock(&session->lock);
+        session_exited(session);
+        pthread_mutex_unlock(&session->lock);
+    }
+}
+
+// Falls back to epoll (returns 0) when io_uring cannot be set up
+static int uring_start(int session_count)
+{
+    unsigned entries = 8;
+    while (entries < (unsigned)session_count * 2 + 8 && entries < URING_MAX_ENTRIES)
+        entries *= 2;
+
+    g_uring = uring_create(entries);
+    if (!g_uring)
+        return 0;
+
+    // Read buffers first, then write buffers; all stay mapped until the ring is closed
+    size_t size = (size_t)session_count * URING_SESSION_MEMORY;
+    g_uring_buffers = mmap(NULL, size > 0 ? size : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    g_uring_write_buffers = g_uring_buffers + (size_t)session_count * URING_BUFFER_SIZE;
+    g_requests = calloc(session_count + 1, sizeof(Session*));
+    g_requests_taken = calloc(session_count + 1, sizeof(Session*));
+
+    g_uring_endpoint.fd = uring_get_fd(g_uring);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &g_uring_endpoint };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_uring_endpoint.fd, &event);
+
+    return 1;
+}
+
+// Once the sessions exist: give each its buffer, register them, queue the first reads
+static void uring_start_sessions()
+{
+    struct iovec* buffers = calloc(g_session_count + 1, sizeof(struct iovec));
+
+    for (int i = 0; i < g_session_count; ++i)
+    {
+        g_sessions[i].buffer = g_uring_buffers + (size_t)i * URING_BUFFER_SIZE;
+        g_sessions[i].write_buffer = g_uring_write_buffers + (size_t)i * URING_WRITE_SIZE;
+        buffers[i].iov_base = g_sessions[i].buffer;
+        buffers[i].iov_len = URING_BUFFER_SIZE;
+    }
+
+    // Pinned memory counts against RLIMIT_MEMLOCK, plain reads work without it
+    g_uring_fixed = g_session_count > 0 && uring_register_buffers(g_uring, buffers, g_session_count);
+    free(buffers);
+
+    for (int i = 0; i < g_session_count; ++i)
+        session_request(&g_sessions[i], REQUEST_READ);
+
+    uring_submit_requests();
+}
+
+static Session* find_session(const char* id_text)
+{
+    char* end;
+    long id = strtol(id_text, &end, 10);
+
+    if (end == id_text || id < 0 || id >= g_session_count)
+        return NULL;
+
+    return &g_sessions[id];
+}
+
+// Reply helpers, a reply is "ok COUNT" and COUNT lines, or a single error line
+static void reply_error(Client* client, const char* message)
+{
+    char line[256];
+    int length = snprintf(line, sizeof(line), "error %s\n", message);
+    endpoint_write(&client->endpoint, line, length);
+}
+
+static void reply_header(Client* client, int line_count)
+{
+    char line[32];
+    int length = snprintf(line, sizeof(line), "ok %d\n", line_count);
+    endpoint_write(&client->endpoint, line, length);
+}
+
+static int unescape(char* text)
+{
+    char* out = text;
+
+    for (char* in = text; *in; ++in)
+    {
+        if (*in != '\\' || in[1] == '\0')
+        {
+            *out++ = *in;
+            continue;
+        }
+
+        ++in;
+        switch (*in)
+        {
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'e': *out++ = '\033'; break;
+            case 'x':
+            {
+                char hex[3] = { 0 };
+                if (in[1]) { hex[0] = in[1]; if (in[2]) hex[1] = in[2]; }
+                char* end;
+                long value = strtol(hex, &end, 16);
+                if (end == hex)
+                {
+                    *out++ = 'x';
+                    break;
+                }
+                *out++ = (char)value;
+                in += end - hex;
+                break;
+            }
+            default: *out++ = *in; break;
+        }
+    }
+
+    *out = '\0';
+
+    return (int)(out - text);
+}
+
+static uint8_t key_from_name(const char* name)
+{
+    static const struct { const char* name; uint8_t key; } keys[] =
+    {
+        { "up", OZTERM_KEY_UP }, { "down", OZTERM_KEY_DOWN },
+        { "left", OZTERM_KEY_LEFT }, { "right", OZTERM_KEY_RIGHT },
+        { "home", OZTERM_KEY_HOME }, { "end", OZTERM_KEY_END },
+        { "pageup", OZTERM_KEY_PAGEUP }, { "pagedown", OZTERM_KEY_PAGEDOWN },
+        { "insert", OZTERM_KEY_INSERT }, { "delete", OZTERM_KEY_DELETE },
+        { "enter", OZTERM_KEY_RETURN }, { "backspace", OZTERM_KEY_BACKSPACE },
+        { "tab", OZTERM_KEY_TAB }, { "escape", OZTERM_KEY_ESCAPE },
+        { "f1", OZTERM_KEY_F1 }, { "f2", OZTERM_KEY_F2 }, { "f3", OZTERM_KEY_F3 },
+        { "f4", OZTERM_KEY_F4 }, { "f5", OZTERM_KEY_F5 }, { "f6", OZTERM_KEY_F6 },
+        { "f7", OZTERM_KEY_F7 }, { "f8", OZTERM_KEY_F8 }, { "f9", OZTERM_KEY_F9 },
+        { "f10", OZTERM_KEY_F10 }, { "f11", OZTERM_KEY_F11 }, { "f12", OZTERM_KEY_F12 },
+    };
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+    {
+        if (strcmp(name, keys[i].name) == 0)
+            return keys[i].key;
+    }
+
+    return OZTERM_KEY_NONE;
+}
+
+static void reply_screen(Client* client, Session* session)
+{
+    int16_t rows = ozterm_get_row_count(session->terminal);
+    int16_t columns = ozterm_get_column_count(session->terminal);
+    char line[columns + 1];
+
+    reply_header(client, rows);
+
+    for (int16_t row = 0; row < rows; ++row)
+    {
+        OztermCell* cells = ozterm_get_row_data(session->terminal, row);
+        int length = 0;
+
+        for (int16_t column = 0; column < columns; ++column)
+        {
+            uint8_t character = cells[column].character;
+            line[column] = (character < 32 || character == 127) ? ' ' : (char)character;
+            if (line[column] != ' ')
+                length = column + 1;
+        }
+
+        line[length] = '\n';
+        endpoint_write(&client->endpoint, line, length + 1);
+    }
+}
+
+// Totals over all sessions as one line
+static void print_stats(char* line, size_t size)
+{
+    uint64_t bytes_read = 0, bytes_written = 0, reads = 0;
+    uint64_t turns = 0, latency_total = 0, latency_max = 0, unhandled = 0;
+    uint64_t memory_live = 0, memory_peak = 0, allocations = 0;
+    int alive = 0;
+
+    for (int i = 0; i < g_session_count; ++i)
+    {
+        Session* session = &g_sessions[i];
+
+        pthread_mutex_lock(&session->lock);
+        ozterm_report_unhandled(session->terminal);
+        unhandled += session->unhandled;
+        bytes_read += session->bytes_read;
+        bytes_written += session->bytes_written;
+        reads += session->reads;
+        alive += session->alive;
+        turns += session->turns;
+        latency_total += session->latency_total;
+        if (session->latency_max > latency_max)
+            latency_max = session->latency_max;
+        memory_live += session->memory.live_bytes;
+        if (session->memory.peak_bytes > memory_peak)
+            memory_peak = session->memory.peak_bytes;
+        allocations += session->memory.allocations;
+        pthread_mutex_unlock(&session->lock);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    uint64_t syscalls = atomic_load(&g_syscalls) + (g_uring ? uring_get_enter_count(g_uring) : 0);
+
+    snprintf(line, size, "backend=%s sessions=%d alive=%d reads=%llu bytes_read=%llu bytes_written=%llu "
+        "syscalls=%llu syscalls_per_mb=%.1f turn_avg_us=%.1f turn_max_us=%llu unhandled=%llu "
+        "terminal_bytes=%llu terminal_peak_bytes=%llu terminal_allocations=%llu max_rss_kb=%ld\n",
+        g_uring ? (g_uring_fixed ? "io_uring" : "io_uring_unregistered") : "epoll",
+        g_session_count, alive, (unsigned long long)reads,
+        (unsigned long long)bytes_read, (unsigned long long)bytes_written,
+        (unsigned long long)syscalls, bytes_read ? syscalls / (bytes_read / (1024.0 * 1024.0)) : 0.0,
+        turns ? (double)latency_total / turns : 0.0, (unsigned long long)latency_max,
+        (unsigned long long)unhandled, (unsigned long long)memory_live, (unsigned long long)memory_peak,
+        (unsigned long long)allocations, usage.ru_maxrss);
+}
+
+static void handle_request(Client* client, char* request)
+{
+    char* argument = request;
+    char* verb = strsep(&argument, " ");
+    char* id_text = argument ? strsep(&argument, " ") : NULL;
+    char line[512];
+
+    if (strcmp(verb, "list") == 0)
+    {
+        reply_header(client, g_session_count);
+        for (int i = 0; i < g_session_count; ++i)
+        {
+            Session* session = &g_sessions[i];
+
+            pthread_mutex_lock(&session->lock);
+            int length = snprintf(line, sizeof(line), "%d %d %d %d %d\n",
+                session->id, (int)session->pid, session->alive,
+                ozterm_get_cursor_row(session->terminal), ozterm_get_cursor_column(session->terminal));
+            pthread_mutex_unlock(&session->lock);
+
+            endpoint_write(&client->endpoint, line, length);
+        }
+    }
+    else if (strcmp(verb, "stats") == 0)
+    {
+        reply_header(client, 1);
+        print_stats(line, sizeof(line));
+        endpoint_write(&client->endpoint, line, strlen(line));
+    }
+    else if (strcmp(verb, "quit") == 0)
+    {
+        reply_header(client, 0);
+        g_running = 0;
+    }
+    else if (strcmp(verb, "screen") == 0 || strcmp(verb, "send") == 0 ||
+             strcmp(verb, "paste") == 0 || strcmp(verb, "key") == 0)
+    {
+        Session* session = id_text ? find_session(id_text) : NULL;
+
+        if (!session)
+        {
+            reply_error(client, "no such session");
+            return;
+        }
+
+        pthread_mutex_lock(&session->lock);
+
+        if (strcmp(verb, "screen") == 0)
+        {
+            reply_screen(client, session);
+        }
+        else if (!session->alive)
+        {
+            reply_error(client, "session has exited");
+        }
+        else if (!argument)
+        {
+            reply_error(client, "missing argument");
+        }
+        else if (strcmp(verb, "key") == 0)
+        {
+            uint8_t key = key_from_name(argument);
+            if (key == OZTERM_KEY_NONE)
+            {
+                reply_error(client, "unknown key");
+            }
+            else
+            {
+                ozterm_send_key(session->terminal, OZTERM_KEYM_NONE, key);
+                reply_header(client, 0);
+            }
+        }
+        else
+        {
+            int length = unescape(argument);
+            if (strcmp(verb, "paste") == 0)
+                ozterm_send_paste(session->terminal, (const uint8_t*)argument, length);
+            else
+                ozterm_send_text(session->terminal, (const uint8_t*)argument, length);
+            reply_header(client, 0);
+        }
+
+        pthread_mutex_unlock(&session->lock);
+    }
+    else
+    {
+        reply_error(client, "unknown request");
+    }
+}
+
+static void client_accept()
+{
+    int fd = accept(g_listen.fd, NULL, NULL);
+    if (fd < 0)
+        return;
+
+    Client* client = malloc(sizeof(Client));
+    if (!client || !endpoint_open(&client->endpoint, ENDPOINT_CLIENT, fd, EPOLLIN))
+    {
+        close(fd);
+        free(client);
+        return;
+    }
+    client->line_length = 0;
+}
+
+static void client_read(Client* client)
+{
+    char buffer[4096];
+    ssize_t length = read(client->endpoint.fd, buffer, sizeof(buffer));
+
+    if (length < 0 && (errno == EINTR || errno == EAGAIN))
+        return;
+
+    if (length <= 0)
+    {
+        endpoint_close(&client->endpoint);
+        queue_destroy(&client->endpoint.output);
+        free(client);
+        return;
+    }
+
+    for (ssize_t i = 0; i < length; ++i)
+    {
+        if (buffer[i] == '\n')
+        {
+            client->line[client->line_length] = '\0';
+            handle_request(client, client->line);
+            client->line_length = 0;
+        }
+        else if (client->line_length < REQUEST_LINE_MAX - 1)
+        {
+            client->line[client->line_length++] = buffer[i];
+        }
+    }
+
+    endpoint_update_events(&client->endpoint);
+}
+
+static int listen_on(const char* path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// -x: sends one request and prints the reply lines
+static int run_client(const char* path, int argc, char** argv)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path))
+        return 1;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+
+    FILE* stream = fdopen(fd, "r+");
+    for (int i = 0; i < argc; ++i)
+        fprintf(stream, i ? " %s" : "%s", argv[i]);
+    fprintf(stream, "\n");
+    fflush(stream);
+
+    char* line = NULL;
+    size_t capacity = 0;
+    int count = 0;
+
+    if (getline(&line, &capacity, stream) <= 0 || sscanf(line, "ok %d", &count) != 1)
+    {
+        fputs(line ? line : "no reply\n", stderr);
+        free(line);
+        fclose(stream);
+        return 1;
+    }
+
+    for (int i = 0; i < count && getline(&line, &capacity, stream) > 0; ++i)
+        fputs(line, stdout);
+
+    free(line);
+    fclose(stream);
+    return 0;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+        "usage: %s [-n sessions] [-j workers] [-e] [-u] [-s socket] [-r rows] [-c columns] [command [args...]]\n"
+        "       %s -x socket request...\n", program, program);
+}
+
+int main(int argc, char** argv)
+{
+    int session_count = 1;
+    int rows = DEFAULT_ROWS;
+    int columns = DEFAULT_COLUMNS;
+    const char* socket_path = DEFAULT_SOCKET;
+    const char* client_socket = NULL;
+    long worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int use_uring = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "+n:j:eus:r:c:x:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'u': use_uring = 1; break;
+            case 'n': session_count = atoi(optarg); break;
+            case 'j': worker_count = atoi(optarg); break;
+            case 'e': g_exit_when_done = 1; break;
+            case 's': socket_path = optarg; break;
+            case 'r': rows = atoi(optarg); break;
+            case 'c': columns = atoi(optarg); break;
+            case 'x': client_socket = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if (client_socket)
+        return run_client(client_socket, argc - optind, argv + optind);
+
+    if (session_count <= 0 || rows <= 0 || columns <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char* default_command[] = { getenv("SHELL") ? getenv("SHELL") : "/bin/sh", NULL };
+    char** command = optind < argc ? argv + optind : default_command;
+
+    // Each session holds a master fd, and with io_uring a pinned buffer
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (use_uring && getrlimit(RLIMIT_MEMLOCK, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_MEMLOCK, &limit);
+    }
+
+    t_loop_thread = 1;
+
+    // Children are reaped by the kernel, a dead session is noticed by its master fd
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    g_epoll_fd = epoll_create1(0);
+
+    g_listen.fd = listen_on(socket_path);
+    if (g_listen.fd < 0)
+    {
+        perror(socket_path);
+        return 1;
+    }
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.ptr = &g_listen };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen.fd, &listen_event);
+
+    // Poked by the worker that sees the last session end
+    g_wake.fd = eventfd(0, EFD_NONBLOCK);
+    struct epoll_event wake_event = { .events = EPOLLIN, .data.ptr = &g_wake };
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_wake.fd, &wake_event);
+
+    atomic_init(&g_alive, 0);
+    g_pool = pool_create((int)worker_count);
+
+    if (use_uring && !uring_start(session_count))
+        fprintf(stderr, "io_uring is not available, using epoll\n");
+
+    g_sessions = calloc(session_count, sizeof(Session));
+    for (int i = 0; i < session_count; ++i)
+    {
+        if (!session_start(&g_sessions[i], i, rows, columns, command))
+        {
+            perror("forkpty");
+            break;
+        }
+        g_session_count++;
+    }
+
+    if (g_uring)
+        uring_start_sessions();
+
+    uint64_t start_time = now_microseconds();
+    struct epoll_event events[MAX_EVENTS];
+
+    while (g_running)
+    {
+        int timeout = -1;
+        if (g_uring)
+        {
+            atomic_store(&g_loop_sleeping, 1);
+            pthread_mutex_lock(&g_requests_lock);
+            if (g_request_count > 0)
+                timeout = 0;
+            pthread_mutex_unlock(&g_requests_lock);
+        }
+
+        int count = epoll_wait(g_epoll_fd, events, MAX_EVENTS, timeout);
+        count_syscall();
+        atomic_store(&g_loop_sleeping, 0);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < count && g_running; ++i)
+        {
+            Endpoint* endpoint = events[i].data.ptr;
+            uint32_t flags = events[i].events;
+
+            if (endpoint->kind == ENDPOINT_LISTEN)
+            {
+                client_accept();
+            }
+            else if (endpoint->kind == ENDPOINT_WAKE)
+            {
+                uint64_t value;
+                read(g_wake.fd, &value, sizeof(value));
+                count_syscall();
+
+                if (g_exit_when_done && atomic_load(&g_alive) == 0)
+                    g_running = 0;
+            }
+            else if (endpoint->kind == ENDPOINT_URING)
+            {
+                uring_reap(g_uring, uring_complete, NULL);
+            }
+            else if (endpoint->kind == ENDPOINT_SESSION)
+            {
+                // One-shot: disarmed until served, the fd belongs to the serving task
+                session_dispatch((Session*)endpoint, session_serve);
+            }
+            else
+            {
+                Client* client = (Client*)endpoint;
+
+                if (flags & EPOLLOUT)
+                {
+                    endpoint_flush(&client->endpoint);
+                    endpoint_update_events(&client->endpoint);
+                }
+
+                if (flags & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    client_read(client);
+            }
+        }
+
+        if (g_uring)
+            uring_submit_requests();
+    }
+
+    pool_destroy(g_pool);
+
+    if (g_exit_when_done)
+    {
+        char line[512];
+        print_stats(line, sizeof(line));
+
+        uint64_t end_time = atomic_load(&g_done_time);
+        double seconds = ((end_time ? end_time : now_microseconds()) - start_time) / 1e6;
+        uint64_t bytes_read = 0;
+        for (int i = 0; i < g_session_count; ++i)
+            bytes_read += g_sessions[i].bytes_read;
+
+        printf("workers=%ld seconds=%.3f mb_per_s=%.1f %s", worker_count, seconds,
+            seconds > 0 ? bytes_read / seconds / (1024 * 1024) : 0.0, line);
+    }
+
+    for (int i = 0; i < g_session_count; ++i)
+    {
+        endpoint_close(&g_sessions[i].endpoint);
+        queue_destroy(&g_sessions[i].endpoint.output);
+        ozterm_destroy(g_sessions[i].terminal);
+        pthread_mutex_destroy(&g_sessions[i].lock);
+    }
+    free(g_sessions);
+
+    // Closing the ring cancels what is still in flight before the buffers go
+    if (g_uring)
+    {
+        uring_destroy(g_uring);
+        munmap(g_uring_buffers, (size_t)session_count * URING_SESSION_MEMORY);
+        free(g_requests);
+        free(g_requests_taken);
+    }
+
+    close(g_wake.fd);
+    close(g_listen.fd);
+    unlink(socket_path);
+    close(g_epoll_fd);
+
+    return 0;
+}
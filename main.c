@@ -36,14 +36,20 @@
 
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/select.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ozterm.h"
+#include "palette.h"
+#include "ring.h"
+#include "queue.h"
+#include "recorder.h"
 
 #define COLS 80
 #define ROWS 25
@@ -62,6 +68,126 @@ static SDL_Texture* g_glyph_cache[128];
 static int g_refresh_screen = 0;
 static int g_master_fd = -1;
 
+#define PTY_RING_SIZE (1 << 20)
+
+#define COMMAND_RING_SIZE 4096
+
+// Bytes for the child that the pty did not take yet. Commands are held while
+// more than the high water mark is pending, until it drains to the low one.
+#define OUTPUT_QUEUE_SIZE 4096
+#define OUTPUT_HIGH_WATER (1 << 20)
+#define OUTPUT_LOW_WATER (64 * 1024)
+
+#define TEXT_QUEUE_SIZE 4096
+
+// Parsing time between looks at the input queue, keeps keys flowing during floods
+#define PARSE_SLICE_US 2000
+
+// How often a held synchronized update is checked for its timeout
+#define SYNCHRONIZED_POLL_MS 16
+
+// Unhandled escape sequences are summed up on stderr at most this often
+#define UNHANDLED_REPORT_MS 5000
+
+// Performance overlay: its numbers are averaged over windows of this length
+#define OVERLAY_WINDOW_MS 500
+#define OVERLAY_LINES 6
+#define OVERLAY_COLUMNS 40
+#define OVERLAY_MARGIN 4
+
+// Latency probes: pause between probes, and how long one may take before it counts as lost.
+// The keys do not occur in base64, so a flooding child can run alongside the echo.
+#define PROBE_INTERVAL_MS 50
+#define PROBE_TIMEOUT_MS 1000
+#define PROBE_KEYS "!#%&*@^~"
+
+// Render benchmark (OZTERM_RENDER_BENCH=file): bytes parsed per frame when the
+// file is not a session recording; recordings are replayed one read per frame
+#define RENDER_BENCH_CHUNK 4096
+
+static int g_refresh_rate = 60;
+
+// Three stages: the reader thread drains the master into g_pty_ring, the
+// parser thread feeds it to the terminal and publishes snapshots, the main
+// thread handles SDL events and renders the latest snapshot.
+static Ring g_pty_ring;
+static atomic_int g_pty_closed;
+static atomic_int g_reader_waiting;
+static atomic_int g_reader_quit;
+static SDL_sem* g_ring_space = NULL;
+static int g_wake_pipe[2] = {-1, -1};
+static _Atomic Uint64 g_pty_signal_time = 0;
+
+static SDL_sem* g_parser_wake = NULL;
+static atomic_int g_parser_wake_pending;
+static atomic_int g_parser_quit;
+
+// Input from the main thread, the terminal is only touched by the parser thread
+typedef enum CommandType
+{
+    COMMAND_KEY,
+    COMMAND_TEXT,
+    COMMAND_PASTE,
+    COMMAND_SCROLL_BY,
+    COMMAND_SCROLL_TO
+} CommandType;
+
+typedef struct Command
+{
+    uint8_t type;
+    uint8_t modifier;
+    uint8_t key;
+    uint8_t probe;      // COMMAND_KEY of the latency harness
+    int32_t value;
+    Uint64 time;
+} Command;
+
+static Ring g_command_ring;
+
+// Bytes of COMMAND_TEXT and COMMAND_PASTE, the command carries their count
+static Queue g_text_queue;
+static SDL_mutex* g_text_lock = NULL;
+
+// Written by the parser thread, flushed by the reader thread when the pty is writable
+static Queue g_output;
+static SDL_mutex* g_output_lock = NULL;
+static atomic_int g_output_blocked;
+static Uint32 g_output_max_pending = 0;
+static Uint64 g_output_stalls = 0;
+
+// Set by OZTERM_RECORD=path, everything the session read and sent goes there
+static Recorder* g_recorder = NULL;
+
+// Pushed by the parser thread after publishing, coalesced until handled
+static Uint32 g_frame_event = 0;
+static atomic_int g_frame_pending;
+static atomic_int g_palette_changed;
+
+// Snapshot being rendered, owned by the main thread
+static const OztermSnapshot* g_snapshot = NULL;
+
+// Wake-up latency from pty readable to the parser thread handling it
+static Uint64 g_wakeup_count = 0;
+static Uint64 g_wakeup_total = 0;
+static Uint64 g_wakeup_max = 0;
+
+// Input latency from the SDL event to the key being written to the pty
+static Uint64 g_input_count = 0;
+static Uint64 g_input_total = 0;
+static Uint64 g_input_max = 0;
+
+// Rows of the framebuffer texture that no longer match the terminal
+static uint8_t g_dirty_rows[ROWS];
+
+// Pending region scroll not yet applied to the framebuffer texture
+static int16_t g_scroll_top = 0;
+static int16_t g_scroll_bottom = 0;
+static int16_t g_scroll_lines = 0;
+
+// Persistent copy of the rendered grid, the back one is only used for scroll blits
+static SDL_Texture* g_framebuffer = NULL;
+static SDL_Texture* g_framebuffer_back = NULL;
+
 static TTF_Font* g_font = NULL;
 static SDL_Renderer* g_renderer = NULL;
 
@@ -75,58 +201,104 @@ typedef struct Terminal
 
 static Terminal* g_terminal = NULL;
 
-SDL_Color g_ansi_colors[16] = {
-    {0, 0, 0},       // Black
-    {205, 0, 0},     // Red
-    {0, 205, 0},     // Green
-    {205, 205, 0},   // Yellow
-    {0, 0, 238},     // Blue
-    {205, 0, 205},   // Magenta
-    {0, 205, 205},   // Cyan
-    {229, 229, 229}, // White (light gray)
-
-    {127, 127, 127}, // Bright Black (dark gray)
-    {255, 0, 0},     // Bright Red
-    {0, 255, 0},     // Bright Green
-    {255, 255, 0},   // Bright Yellow
-    {92, 92, 255},   // Bright Blue
-    {255, 0, 255},   // Bright Magenta
-    {0, 255, 255},   // Bright Cyan
-    {255, 255, 255}  // Bright White
-};
-
-#include <SDL.h>
-
-// Build on your existing ANSI 16‐color table
-extern SDL_Color g_ansi_colors[16];
+// Draw work of the last rendered frame
+typedef struct RenderStats
+{
+    int rows;
+    int cells;
+    int background_fills;
+    int glyphs;
+    int draw_calls;
+    int texture_binds;
+} RenderStats;
+
+static RenderStats g_render_stats;
+static SDL_Texture* g_bound_texture = NULL;
+
+// Ctrl+Shift+P shows frame timing over the terminal. It is drawn after the framebuffer
+// like the cursor, so it never dirties rows, and its own drawing is not counted.
+typedef struct Overlay
+{
+    int visible;
+    SDL_TimerID timer;
+    // accumulated over the current window
+    Uint64 window_start;
+    int frames;
+    Uint64 render_ticks;
+    Uint64 cells;
+    Uint64 draw_calls;
+    Uint64 texture_binds;
+    // shown until the next window ends
+    char lines[OVERLAY_LINES][OVERLAY_COLUMNS];
+    int line_count;
+} Overlay;
+
+static Overlay g_overlay;
+static Uint32 g_overlay_event = 0;
+static atomic_int g_overlay_visible;
+
+// Parser work for the overlay, taken and reset by the main thread every window
+static _Atomic Uint64 g_parsed_bytes = 0;
+static _Atomic Uint64 g_parse_ticks = 0;
+
+// Copy of the terminal's latency histograms (OZTERM_TIMING), refreshed by the parser thread
+static OztermTiming g_timing_copy;
+static int g_timing_valid = 0;
+static SDL_mutex* g_timing_lock = NULL;
+
+// Keypress-to-screen harness (OZTERM_LATENCY_PROBES=count). One probe key is in flight at
+// a time: stamped entering ozterm_send_key, spotted in the pty stream by the parser and
+// done when the first frame holding its echo is presented. Needs a child that echoes.
+typedef enum ProbeState
+{
+    PROBE_IDLE,
+    PROBE_SENT,
+    PROBE_ECHOED
+} ProbeState;
 
-// Convert an xterm-256 color index into an SDL_Color
-SDL_Color xterm256_to_sdl(int idx) {
-    SDL_Color c = {0,0,0,255};
-    if (idx >= 0 && idx < 16) {
-        // standard ANSI
-        return g_ansi_colors[idx];
-    }
-    else if (idx >= 16 && idx <= 231) {
-        // 6×6×6 cube
-        int ci = idx - 16;
-        int blue  = (ci % 6);
-        int green = (ci / 6) % 6;
-        int red   = (ci / 36) % 6;
-        // each step is 51 (0x33) to cover 0–255
-        c.r = red   * 51;
-        c.g = green * 51;
-        c.b = blue  * 51;
-    }
-    else if (idx >= 232 && idx <= 255) {
-        // gray ramp, 24 steps from ~8 to ~238
-        int gi = idx - 232;
-        uint8_t level = 8 + gi * 10;
-        c.r = c.g = c.b = level;
+typedef struct LatencyProbes
+{
+    int target;
+    int started;
+    int lost;
+    int done;
+    ProbeState state;
+    uint8_t key;
+    Uint64 event_time;   // SDL event, main thread
+    Uint64 send_time;    // entering ozterm_send_key, parser thread
+    Uint64 echo_time;    // echo reached the parser
+    uint32_t frame;      // first snapshot holding the echo
+    double* queue_ms;    // event to ozterm_send_key
+    double* echo_ms;     // ozterm_send_key to echo
+    double* present_ms;  // echo to present
+    double* total_ms;    // ozterm_send_key to present
+} LatencyProbes;
+
+static LatencyProbes g_probes;
+static SDL_mutex* g_probe_lock = NULL;
+static Uint32 g_probe_event = 0;
+// Key whose echo the parser looks for, 0 when none is expected
+static atomic_int g_probe_key;
+// Snapshot the main thread last acquired
+static uint32_t g_acquired_frame = 0;
+
+static void render_copy(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* src, const SDL_Rect* dst)
+{
+    if (texture != g_bound_texture)
+    {
+        g_bound_texture = texture;
+        g_render_stats.texture_binds++;
     }
-    return c;
+
+    g_render_stats.draw_calls++;
+    SDL_RenderCopy(renderer, texture, src, dst);
 }
 
+static void render_fill(SDL_Renderer* renderer, const SDL_Rect* rect)
+{
+    g_render_stats.draw_calls++;
+    SDL_RenderFillRect(renderer, rect);
+}
 
 void build_g_glyph_cache(SDL_Renderer* renderer, TTF_Font* font, SDL_Color fg)
 {
@@ -139,12 +311,12 @@ void build_g_glyph_cache(SDL_Renderer* renderer, TTF_Font* font, SDL_Color fg)
     }
 }
 
-int get_scrollbar_height(Ozterm* term)
+int get_scrollbar_height(const OztermSnapshot* snapshot)
 {
-    int16_t row_count = ozterm_get_row_count(term);
+    int16_t row_count = ozterm_snapshot_get_row_count(snapshot);
 
     int win_height = row_count * g_font_height;
-    int total_lines = ozterm_get_scroll_count(term) + row_count;
+    int total_lines = ozterm_snapshot_get_scroll_count(snapshot) + row_count;
     int visible_lines = row_count;
 
     // Calculate scrollbar height and position
@@ -155,19 +327,19 @@ int get_scrollbar_height(Ozterm* term)
     return bar_height;
 }
 
-void draw_scrollbar(SDL_Renderer* renderer, Ozterm* term)
+void draw_scrollbar(SDL_Renderer* renderer, const OztermSnapshot* snapshot)
 {
-    int16_t scrollback_count = ozterm_get_scroll_count(term);
+    int16_t scrollback_count = ozterm_snapshot_get_scroll_count(snapshot);
 
     // Only show scrollbar if scrollback exists
     if (scrollback_count > 0)
     {
-        int scroll_offset = ozterm_get_scroll(term);
+        int scroll_offset = ozterm_snapshot_get_scroll(snapshot);
 
-        int win_height = ozterm_get_row_count(term) * g_font_height;
-        int bar_x = ozterm_get_column_count(term) * g_font_width - SCROLLBAR_WIDTH - SCROLLBAR_MARGIN;
+        int win_height = ozterm_snapshot_get_row_count(snapshot) * g_font_height;
+        int bar_x = ozterm_snapshot_get_column_count(snapshot) * g_font_width - SCROLLBAR_WIDTH - SCROLLBAR_MARGIN;
 
-        int bar_height = get_scrollbar_height(term);
+        int bar_height = get_scrollbar_height(snapshot);
 
         int max_offset = scrollback_count;
         if (max_offset == 0) max_offset = 1; // avoid divide-by-zero
@@ -178,23 +350,23 @@ void draw_scrollbar(SDL_Renderer* renderer, Ozterm* term)
         SDL_Rect bar = { bar_x, bar_y, SCROLLBAR_WIDTH, bar_height };
 
         SDL_SetRenderDrawColor(renderer, SCROLLBAR_COLOR_R, SCROLLBAR_COLOR_G, SCROLLBAR_COLOR_B, 255);
-        SDL_RenderFillRect(renderer, &bar);
+        render_fill(renderer, &bar);
     }
 }
 
-void draw_cursor(SDL_Renderer* renderer, Ozterm* term)
+void draw_cursor(SDL_Renderer* renderer, const OztermSnapshot* snapshot)
 {
-    int16_t scroll_offset = ozterm_get_scroll(term);
+    int16_t scroll_offset = ozterm_snapshot_get_scroll(snapshot);
 
     // Only draw the cursor when not scrolled
     if (scroll_offset != 0)
         return;
 
-    int16_t cursor_row = ozterm_get_cursor_row(term);
-    int16_t cursor_column = ozterm_get_cursor_column(term);
+    int16_t cursor_row = ozterm_snapshot_get_cursor_row(snapshot);
+    int16_t cursor_column = ozterm_snapshot_get_cursor_column(snapshot);
 
-    OztermCell* row = ozterm_get_row_data(term, cursor_row);
-    OztermCell* cell = row + cursor_column;
+    const OztermCell* row = ozterm_snapshot_get_row_data(snapshot, cursor_row);
+    const OztermCell* cell = row + cursor_column;
 
     SDL_Rect dst = {cursor_column * g_font_width, cursor_row * g_font_height, g_font_width, g_font_height};
 
@@ -205,121 +377,1125 @@ void draw_cursor(SDL_Renderer* renderer, Ozterm* term)
     if (bg.index == fg.index)
     {
         //fallback to default reverse
-        ozterm_get_default_color(term, &bg, &fg);
+        ozterm_snapshot_get_default_color(snapshot, &bg, &fg);
     }
 
-    
-    SDL_Color color = xterm256_to_sdl(bg.index);
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
-    SDL_RenderFillRect(renderer, &dst);
+    uint32_t color = palette_resolve(&bg);
+    SDL_SetRenderDrawColor(renderer, PALETTE_R(color), PALETTE_G(color), PALETTE_B(color), 255);
+    render_fill(renderer, &dst);
 
     char ch = cell->character;
     if (ch >= 32 && ch < 127)
     {
-        SDL_Color color = xterm256_to_sdl(fg.index);
-        SDL_SetTextureColorMod(g_glyph_cache[ch], color.r, color.g, color.b);
+        color = palette_resolve(&fg);
+        SDL_SetTextureColorMod(g_glyph_cache[(int)ch], PALETTE_R(color), PALETTE_G(color), PALETTE_B(color));
 
-        SDL_RenderCopy(renderer, g_glyph_cache[(int)ch], NULL, &dst);
+        render_copy(renderer, g_glyph_cache[(int)ch], NULL, &dst);
     }
 }
 
-static void render_character(SDL_Renderer* renderer, int x, int y, OztermCell* cell)
+static void mark_all_dirty()
 {
-    char ch = cell->character;
-    if (ch >= 32 && ch < 127)
+    memset(g_dirty_rows, 1, sizeof(g_dirty_rows));
+    g_scroll_lines = 0;
+    g_refresh_screen = 1;
+}
+
+static void mark_scroll(int16_t top, int16_t bottom, int16_t lines)
+{
+    if (g_scroll_lines != 0 && (top != g_scroll_top || bottom != g_scroll_bottom))
     {
-        SDL_Rect dst = {x * g_font_width, y * g_font_height, g_font_width, g_font_height};
+        // Only one blit is kept per frame, a different region means redraw
+        mark_all_dirty();
+        return;
+    }
+
+    g_refresh_screen = 1;
+    g_scroll_top = top;
+    g_scroll_bottom = bottom;
+    g_scroll_lines = ozterm_shift_dirty_rows(g_dirty_rows, top, bottom, g_scroll_lines, lines);
+}
+
+static void apply_scroll(SDL_Renderer* renderer)
+{
+    if (g_scroll_lines == 0)
+        return;
+
+    int width = COLS * g_font_width;
+    int lines = g_scroll_lines;
+    int moved = g_scroll_bottom - g_scroll_top + 1 - abs(lines);
+
+    SDL_Rect src = {0, g_scroll_top * g_font_height, width, moved * g_font_height};
+    SDL_Rect dst = src;
 
-        SDL_Color bg = xterm256_to_sdl(0);
-        SDL_Color fg = xterm256_to_sdl(0);
+    if (lines > 0)
+        src.y += lines * g_font_height;
+    else
+        dst.y -= lines * g_font_height;
 
-        if (cell->bg_color.use_rgb)
+    // A texture cannot be copied onto itself, so shift into the back one and swap
+    SDL_SetRenderTarget(renderer, g_framebuffer_back);
+    render_copy(renderer, g_framebuffer, NULL, NULL);
+    render_copy(renderer, g_framebuffer, &src, &dst);
+
+    SDL_Texture* swap = g_framebuffer;
+    g_framebuffer = g_framebuffer_back;
+    g_framebuffer_back = swap;
+
+    g_scroll_lines = 0;
+}
+
+static void render_row(SDL_Renderer* renderer, const OztermSnapshot* snapshot, int y)
+{
+    const OztermCell* row = ozterm_snapshot_get_row_data(snapshot, y);
+    int16_t column_count = ozterm_snapshot_get_column_count(snapshot);
+
+    OztermColor default_fg, default_bg;
+    ozterm_snapshot_get_default_color(snapshot, &default_fg, &default_bg);
+    uint32_t clear_color = palette_resolve(&default_bg);
+
+    SDL_Rect dst = {0, y * g_font_height, column_count * g_font_width, g_font_height};
+    SDL_SetRenderDrawColor(renderer, PALETTE_R(clear_color), PALETTE_G(clear_color), PALETTE_B(clear_color), 255);
+    render_fill(renderer, &dst);
+    g_render_stats.background_fills++;
+
+    // One fill per run of equal background, runs of the cleared color are already done
+    int x = 0;
+    while (x < column_count)
+    {
+        uint32_t bg = palette_resolve(&row[x].bg_color);
+        int run_start = x;
+
+        while (x < column_count && palette_resolve(&row[x].bg_color) == bg)
+            ++x;
+
+        if (bg != clear_color)
         {
-            bg.r = cell->bg_color.red;
-            bg.g = cell->bg_color.green;
-            bg.b = cell->bg_color.blue;
+            SDL_Rect run = {run_start * g_font_width, y * g_font_height, (x - run_start) * g_font_width, g_font_height};
+            SDL_SetRenderDrawColor(renderer, PALETTE_R(bg), PALETTE_G(bg), PALETTE_B(bg), 255);
+            render_fill(renderer, &run);
+            g_render_stats.background_fills++;
         }
-        else
+    }
+
+    for (x = 0; x < column_count; ++x)
+    {
+        char ch = row[x].character;
+        if (ch > 32 && ch < 127)
         {
-            bg = xterm256_to_sdl(cell->bg_color.index);
+            SDL_Rect glyph = {x * g_font_width, y * g_font_height, g_font_width, g_font_height};
+            uint32_t fg = palette_resolve(&row[x].fg_color);
+
+            SDL_SetTextureColorMod(g_glyph_cache[(int)ch], PALETTE_R(fg), PALETTE_G(fg), PALETTE_B(fg));
+            render_copy(renderer, g_glyph_cache[(int)ch], NULL, &glyph);
+            g_render_stats.glyphs++;
         }
-        SDL_SetRenderDrawColor(renderer, bg.r, bg.g, bg.b, 255);
-        SDL_RenderFillRect(renderer, &dst);
+    }
+
+    g_render_stats.rows++;
+    g_render_stats.cells += column_count;
+}
+
+void render_screen(SDL_Renderer* renderer, TTF_Font* font)
+{
+    const OztermSnapshot* snapshot = g_snapshot;
+
+    memset(&g_render_stats, 0, sizeof(g_render_stats));
+    g_bound_texture = NULL;
 
-        if (cell->fg_color.use_rgb)
+    apply_scroll(renderer);
+
+    SDL_SetRenderTarget(renderer, g_framebuffer);
+
+    int16_t row_count = ozterm_snapshot_get_row_count(snapshot);
+
+    for (int y = 0; y < row_count; ++y)
+    {
+        if (g_dirty_rows[y])
         {
-            fg.r = cell->fg_color.red;
-            fg.g = cell->fg_color.green;
-            fg.b = cell->fg_color.blue;
+            render_row(renderer, snapshot, y);
+            g_dirty_rows[y] = 0;
+        }
+    }
+
+    // Cursor and scrollbar are drawn over the framebuffer, never into it
+    SDL_SetRenderTarget(renderer, NULL);
+    render_copy(renderer, g_framebuffer, NULL, NULL);
+
+    int16_t scroll_offset = ozterm_snapshot_get_scroll(snapshot);
+
+    if (scroll_offset > 0)
+        draw_scrollbar(renderer, snapshot);
+
+    draw_cursor(renderer, snapshot);
+}
+
+// Closes the measuring window and formats what the overlay shows for the next one
+static void overlay_update(Uint64 now)
+{
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double window = (now - g_overlay.window_start) / frequency;
+    int frames = g_overlay.frames > 0 ? g_overlay.frames : 1;
+
+    Uint64 parsed = atomic_exchange(&g_parsed_bytes, 0);
+    Uint64 parse_ticks = atomic_exchange(&g_parse_ticks, 0);
+
+    int n = 0;
+    snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "fps %5.1f  frame %5.2f ms",
+        g_overlay.frames / window, g_overlay.frames ? 1e3 * window / g_overlay.frames : 0.0);
+    snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "render %5.2f ms/frame",
+        1e3 * g_overlay.render_ticks / frequency / frames);
+    snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "busy parser %3.0f%% render %3.0f%%",
+        100.0 * parse_ticks / frequency / window, 100.0 * g_overlay.render_ticks / frequency / window);
+    snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "cells %llu draws %llu binds %llu",
+        (unsigned long long)(g_overlay.cells / frames), (unsigned long long)(g_overlay.draw_calls / frames),
+        (unsigned long long)(g_overlay.texture_binds / frames));
+    snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "parsed %7.2f MB/s", parsed / 1e6 / window);
+
+    SDL_LockMutex(g_timing_lock);
+    if (g_timing_valid)
+    {
+        uint64_t callback_total = 0;
+        for (int i = 0; i < OZTERM_CALLBACK_COUNT; ++i)
+        {
+            callback_total += g_timing_copy.callbacks[i].total;
+        }
+
+        snprintf(g_overlay.lines[n++], OVERLAY_COLUMNS, "chunk p50 %.0f p99 %.0f us cb %.0f%%",
+            ozterm_histogram_percentile(&g_timing_copy.chunk, 50) / 1e3,
+            ozterm_histogram_percentile(&g_timing_copy.chunk, 99) / 1e3,
+            g_timing_copy.chunk.total ? 100.0 * callback_total / g_timing_copy.chunk.total : 0.0);
+    }
+    SDL_UnlockMutex(g_timing_lock);
+
+    g_overlay.line_count = n;
+    g_overlay.window_start = now;
+    g_overlay.frames = 0;
+    g_overlay.render_ticks = 0;
+    g_overlay.cells = 0;
+    g_overlay.draw_calls = 0;
+    g_overlay.texture_binds = 0;
+}
+
+static void overlay_add_frame(Uint64 render_ticks)
+{
+    g_overlay.frames++;
+    g_overlay.render_ticks += render_ticks;
+    g_overlay.cells += g_render_stats.cells;
+    g_overlay.draw_calls += g_render_stats.draw_calls;
+    g_overlay.texture_binds += g_render_stats.texture_binds;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (now - g_overlay.window_start >= SDL_GetPerformanceFrequency() * OVERLAY_WINDOW_MS / 1000)
+        overlay_update(now);
+}
+
+// Straight SDL calls, so the overlay stays out of g_render_stats
+static void draw_overlay(SDL_Renderer* renderer)
+{
+    int width = 0;
+    for (int i = 0; i < g_overlay.line_count; ++i)
+    {
+        width = MAX(width, (int)strlen(g_overlay.lines[i]));
+    }
+
+    int window_width = COLS * g_font_width;
+    SDL_Rect box = {
+        window_width - width * g_font_width - 3 * OVERLAY_MARGIN, OVERLAY_MARGIN,
+        width * g_font_width + 2 * OVERLAY_MARGIN, g_overlay.line_count * g_font_height + 2 * OVERLAY_MARGIN
+    };
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 192);
+    SDL_RenderFillRect(renderer, &box);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+
+    for (int i = 0; i < g_overlay.line_count; ++i)
+    {
+        for (int x = 0; g_overlay.lines[i][x]; ++x)
+        {
+            char ch = g_overlay.lines[i][x];
+            if (ch > 32 && ch < 127)
+            {
+                SDL_Rect glyph = {
+                    box.x + OVERLAY_MARGIN + x * g_font_width, box.y + OVERLAY_MARGIN + i * g_font_height,
+                    g_font_width, g_font_height
+                };
+                SDL_SetTextureColorMod(g_glyph_cache[(int)ch], 255, 255, 0);
+                SDL_RenderCopy(renderer, g_glyph_cache[(int)ch], NULL, &glyph);
+            }
+        }
+    }
+}
+
+// Idle terminals render no frames, this keeps the overlay's numbers moving
+static Uint32 overlay_timer(Uint32 interval, void* data)
+{
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = g_overlay_event;
+    SDL_PushEvent(&e);
+
+    return interval;
+}
+
+static void toggle_overlay()
+{
+    g_overlay.visible = !g_overlay.visible;
+    atomic_store(&g_overlay_visible, g_overlay.visible);
+
+    if (g_overlay.visible)
+    {
+        // Start clean, the counters ran while hidden
+        atomic_store(&g_parsed_bytes, 0);
+        atomic_store(&g_parse_ticks, 0);
+        g_overlay.window_start = SDL_GetPerformanceCounter();
+        g_overlay.line_count = 0;
+        g_overlay.timer = SDL_AddTimer(OVERLAY_WINDOW_MS, overlay_timer, NULL);
+    }
+    else
+    {
+        SDL_RemoveTimer(g_overlay.timer);
+    }
+
+    // The framebuffer copy covers the old overlay, no row needs redrawing
+    g_refresh_screen = 1;
+}
+
+
+static void wake_parser()
+{
+    if (!atomic_exchange(&g_parser_wake_pending, 1))
+        SDL_SemPost(g_parser_wake);
+}
+
+static Uint32 output_pending()
+{
+    SDL_LockMutex(g_output_lock);
+    Uint32 pending = g_output.size;
+    SDL_UnlockMutex(g_output_lock);
+
+    return pending;
+}
+
+// Writes what the pty takes without blocking, called with g_output_lock held
+static void flush_output_locked()
+{
+    const uint8_t* span;
+    uint32_t size;
+
+    while ((size = queue_peek(&g_output, &span)) > 0)
+    {
+        ssize_t written = write(g_master_fd, span, size);
+
+        if (written > 0)
+        {
+            queue_pop(&g_output, (uint32_t)written);
+        }
+        else if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (written < 0 && (errno == EIO || errno == EPIPE))
+        {
+            // Child is gone, nobody will read it
+            queue_pop(&g_output, g_output.size);
         }
         else
         {
-            fg = xterm256_to_sdl(cell->fg_color.index);
+            // Full or a passing error, the rest goes on the next POLLOUT
+            break;
         }
-        SDL_SetTextureColorMod(g_glyph_cache[ch], fg.r, fg.g, fg.b);
+    }
+}
+
+static void flush_output()
+{
+    SDL_LockMutex(g_output_lock);
+    flush_output_locked();
+    Uint32 pending = g_output.size;
+    SDL_UnlockMutex(g_output_lock);
+
+    if (pending <= OUTPUT_LOW_WATER && atomic_exchange(&g_output_blocked, 0))
+        wake_parser();
+}
+
+// Never blocks: what the child is not reading yet waits in g_output
+static void write_to_master(Ozterm* term, const uint8_t* data, int32_t size)
+{
+    if (g_master_fd < 0 || size <= 0)
+        return;
+
+    SDL_LockMutex(g_output_lock);
+
+    int was_empty = g_output.size == 0;
+    queue_push(&g_output, data, (uint32_t)size);
+
+    if (was_empty)
+        flush_output_locked();
 
-        SDL_RenderCopy(renderer, g_glyph_cache[(int)ch], NULL, &dst);
+    int queued = was_empty && g_output.size > 0;
+    g_output_max_pending = MAX(g_output_max_pending, g_output.size);
+
+    SDL_UnlockMutex(g_output_lock);
+
+    // The reader thread polls for writability only when there is something to write
+    if (queued)
+        write(g_wake_pipe[1], "", 1);
+}
+
+static void record_session(Ozterm* term, uint8_t direction, const uint8_t* data, int32_t size)
+{
+    recorder_write(g_recorder, direction, data, size);
+}
+
+// On the parser thread, one line per interval no matter how much the application sends
+static void report_unhandled(Ozterm* term, const OztermUnhandled* sequences, int32_t count, uint32_t others)
+{
+    char line[1024];
+    int length = snprintf(line, sizeof(line), "unhandled:");
+
+    for (int32_t i = 0; i < count && length < (int)sizeof(line); ++i)
+    {
+        char param[16] = "";
+        if (sequences[i].first_param >= 0)
+            snprintf(param, sizeof(param), "%d", sequences[i].first_param);
+
+        char intermediate[2] = { sequences[i].intermediate, 0 };
+
+        length += snprintf(line + length, sizeof(line) - length, " CSI %s%s%s%c x%u",
+            sequences[i].is_private ? "?" : "", param, intermediate, sequences[i].final_byte, sequences[i].count);
     }
+
+    if (others > 0 && length < (int)sizeof(line))
+        snprintf(line + length, sizeof(line) - length, " others x%u", others);
+
+    fprintf(stderr, "%s\n", line);
 }
 
-void render_screen(SDL_Renderer* renderer, TTF_Font* font)
+static void terminal_set_palette(Ozterm* term, int16_t index, uint8_t red, uint8_t green, uint8_t blue)
 {
-    Ozterm* term = g_terminal->term;
+    // The default colors have their own entries, cells set to 37 or 40 keep theirs
+    palette_set(index, red, green, blue);
 
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+    // Picked up by the main thread with the next snapshot
+    atomic_store(&g_palette_changed, 1);
+}
 
-    int16_t row_count = ozterm_get_row_count(term);
-    int16_t column_count = ozterm_get_column_count(term);
+static void notify_pty_data()
+{
+    // Latency is measured from the first byte the parser has not seen yet
+    Uint64 none = 0;
+    atomic_compare_exchange_strong(&g_pty_signal_time, &none, SDL_GetPerformanceCounter());
 
-    for (int y = 0; y < row_count; ++y)
+    wake_parser();
+}
+
+static int push_command(Command* command)
+{
+    uint8_t* span;
+
+    // Commands are 16 bytes and the ring size is a multiple, so spans never split one
+    if (ring_write_span(&g_command_ring, &span) < sizeof(Command))
+        return 0;
+
+    command->time = SDL_GetPerformanceCounter();
+    memcpy(span, command, sizeof(*command));
+    ring_commit(&g_command_ring, sizeof(*command));
+
+    wake_parser();
+    return 1;
+}
+
+static void send_command(uint8_t type, uint8_t modifier, uint8_t key, int32_t value)
+{
+    Command command = { .type = type, .modifier = modifier, .key = key, .value = value };
+    push_command(&command);
+}
+
+static void send_text_command(uint8_t type, const char* text, size_t size)
+{
+    uint8_t* span;
+
+    // Only this thread adds commands, so the space seen here is still there when sending
+    if (size == 0 || size > INT32_MAX || ring_write_span(&g_command_ring, &span) < sizeof(Command))
+        return;
+
+    SDL_LockMutex(g_text_lock);
+    int pushed = queue_push(&g_text_queue, (const uint8_t*)text, (uint32_t)size);
+    SDL_UnlockMutex(g_text_lock);
+
+    if (pushed)
+        send_command(type, OZTERM_KEYM_NONE, 0, (int32_t)size);
+}
+
+// Text of a command in one buffer, as the terminal encodes it in one go
+static uint8_t* take_text(int32_t size)
+{
+    uint8_t* text = malloc(size);
+    int32_t taken = 0;
+
+    SDL_LockMutex(g_text_lock);
+    while (taken < size)
     {
-        OztermCell* row = ozterm_get_row_data(term, y);
+        const uint8_t* span;
+        uint32_t length = queue_peek(&g_text_queue, &span);
+        if (length > (uint32_t)(size - taken))
+            length = size - taken;
+
+        if (text)
+            memcpy(text + taken, span, length);
+        queue_pop(&g_text_queue, length);
+        taken += length;
+    }
+    SDL_UnlockMutex(g_text_lock);
+
+    return text;
+}
 
-        for (int x = 0; x < column_count; ++x)
+static void notify_frame()
+{
+    if (!atomic_exchange(&g_frame_pending, 1))
+    {
+        SDL_Event e;
+        memset(&e, 0, sizeof(e));
+        e.type = g_frame_event;
+        SDL_PushEvent(&e);
+    }
+}
+
+static void wait_ring_space()
+{
+    uint8_t* span;
+
+    atomic_store(&g_reader_waiting, 1);
+
+    if (ring_write_span(&g_pty_ring, &span) == 0)
+    {
+        SDL_SemWait(g_ring_space);
+    }
+    else if (!atomic_exchange(&g_reader_waiting, 0))
+    {
+        // The consumer freed space and posted meanwhile, take that post
+        SDL_SemWait(g_ring_space);
+    }
+}
+
+static int pty_reader_thread(void* data)
+{
+    struct pollfd fds[2] =
+    {
+        { .fd = g_master_fd, .events = POLLIN },
+        { .fd = g_wake_pipe[0], .events = POLLIN },
+    };
+
+    while (!atomic_load(&g_reader_quit))
+    {
+        uint8_t* span;
+        uint32_t space = ring_write_span(&g_pty_ring, &span);
+        int writing = output_pending() > 0;
+
+        if (space == 0 && !writing)
+        {
+            // Parser is behind, the child gets backpressure from the pty
+            wait_ring_space();
+            continue;
+        }
+
+        fds[0].events = (space > 0 ? POLLIN : 0) | (writing ? POLLOUT : 0);
+
+        if (poll(fds, 2, -1) < 0)
         {
-            SDL_Rect dst = {x * g_font_width, y * g_font_height, g_font_width, g_font_height};
+            if (errno == EINTR)
+                continue;
+            break;
+        }
 
-            OztermCell* cell = row + x;
+        if (fds[1].revents)
+        {
+            // Quit request or new output, both are looked at below
+            char drain[64];
+            while (read(g_wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+        }
 
-            render_character(renderer, x, y, cell);
+        if (writing && (fds[0].revents & (POLLOUT | POLLHUP | POLLERR)))
+        {
+            flush_output();
+        }
+
+        if (space > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            ssize_t len = read(g_master_fd, span, space);
+
+            if (len > 0)
+            {
+                ring_commit(&g_pty_ring, (uint32_t)len);
+                notify_pty_data();
+            }
+            else if (len < 0 && (errno == EINTR || errno == EAGAIN))
+            {
+                continue;
+            }
+            else
+            {
+                // Child has exited
+                atomic_store(&g_pty_closed, 1);
+                atomic_store(&g_parser_wake_pending, 0);
+                wake_parser();
+                break;
+            }
         }
     }
 
-    int16_t scroll_offset = ozterm_get_scroll(term);
+    return 0;
+}
 
-    if (scroll_offset > 0)
-        draw_scrollbar(renderer, term);
+// Parser thread side of the latency harness: the probe key is about to be written
+static void probe_sending(uint8_t key, Uint64 event_time)
+{
+    SDL_LockMutex(g_probe_lock);
+    g_probes.event_time = event_time;
+    g_probes.send_time = SDL_GetPerformanceCounter();
+    SDL_UnlockMutex(g_probe_lock);
 
-    draw_cursor(renderer, term);
+    atomic_store(&g_probe_key, key);
 }
 
+// Looks for the echo of the probe key in bytes just parsed. The echo shows up
+// in the first snapshot published after this, whose number is kept.
+static void probe_check_echo(Ozterm* term, const uint8_t* data, uint32_t size)
+{
+    int key = atomic_load(&g_probe_key);
+    if (key == 0 || !memchr(data, key, size))
+        return;
 
-static void write_to_master(Ozterm* term, const uint8_t* data, int32_t size)
+    atomic_store(&g_probe_key, 0);
+
+    SDL_LockMutex(g_probe_lock);
+    if (g_probes.state == PROBE_SENT && g_probes.key == key)
+    {
+        g_probes.echo_time = SDL_GetPerformanceCounter();
+        g_probes.frame = ozterm_get_snapshot_sequence(term) + 1;
+        g_probes.state = PROBE_ECHOED;
+    }
+    SDL_UnlockMutex(g_probe_lock);
+}
+
+static void run_commands(Ozterm* term)
 {
-    if (g_master_fd >= 0)
+    const uint8_t* span;
+    uint32_t size;
+
+    while ((size = ring_read_span(&g_command_ring, &span)) >= sizeof(Command))
     {
-        write(g_master_fd, data, size);
+        // The child is not keeping up with our input, the reader wakes us once it drained
+        if (output_pending() > OUTPUT_HIGH_WATER)
+        {
+            atomic_store(&g_output_blocked, 1);
+
+            // Check again, the reader may have drained it before seeing the flag
+            if (output_pending() > OUTPUT_HIGH_WATER)
+            {
+                g_output_stalls++;
+                break;
+            }
+
+            atomic_store(&g_output_blocked, 0);
+        }
+
+        Command command;
+        memcpy(&command, span, sizeof(command));
+
+        switch (command.type)
+        {
+            case COMMAND_KEY:
+            {
+                if (command.probe)
+                    probe_sending(command.key, command.time);
+
+                ozterm_send_key(term, command.modifier, command.key);
+
+                Uint64 latency = SDL_GetPerformanceCounter() - command.time;
+                g_input_total += latency;
+                g_input_max = MAX(g_input_max, latency);
+                g_input_count++;
+                break;
+            }
+            case COMMAND_TEXT:
+            case COMMAND_PASTE:
+            {
+                uint8_t* text = take_text(command.value);
+                if (text)
+                {
+                    if (command.type == COMMAND_PASTE)
+                        ozterm_send_paste(term, text, command.value);
+                    else
+                        ozterm_send_text(term, text, command.value);
+                    free(text);
+                }
+
+                Uint64 latency = SDL_GetPerformanceCounter() - command.time;
+                g_input_total += latency;
+                g_input_max = MAX(g_input_max, latency);
+                g_input_count++;
+                break;
+            }
+            case COMMAND_SCROLL_BY:
+                ozterm_scroll(term, ozterm_get_scroll(term) + command.value);
+                break;
+            case COMMAND_SCROLL_TO:
+                ozterm_scroll(term, command.value);
+                break;
+        }
+
+        ring_consume(&g_command_ring, sizeof(command));
     }
 }
 
-static void terminal_refresh(Ozterm* term)
+// Feeds what the reader has committed so far straight from the ring, until
+// the deadline. Returns 1 if unparsed data is left, i.e. output is flooding.
+static int consume_pty_ring(Ozterm* term, Uint64 deadline)
 {
-    g_refresh_screen = 1;
+    Uint64 signal_time = atomic_exchange(&g_pty_signal_time, 0);
+    if (signal_time)
+    {
+        Uint64 latency = SDL_GetPerformanceCounter() - signal_time;
+        g_wakeup_total += latency;
+        g_wakeup_max = MAX(g_wakeup_max, latency);
+        g_wakeup_count++;
+    }
+
+    // Bounded by what is there now, newer data comes with a new wake-up
+    uint32_t available = ring_used(&g_pty_ring);
+
+    while (available > 0)
+    {
+        const uint8_t* span;
+        uint32_t size = ring_read_span(&g_pty_ring, &span);
+        if (size > available)
+            size = available;
+
+        int32_t consumed = ozterm_have_read_from_master_budget(term, span, (int32_t)size, 0, PARSE_SLICE_US);
+        probe_check_echo(term, span, (uint32_t)consumed);
+
+        ring_consume(&g_pty_ring, (uint32_t)consumed);
+        available -= (uint32_t)consumed;
+        atomic_fetch_add(&g_parsed_bytes, (Uint64)consumed);
+
+        if (atomic_exchange(&g_reader_waiting, 0))
+            SDL_SemPost(g_ring_space);
+
+        // Ctrl-C during a flood should not wait for the flood
+        if (ring_used(&g_command_ring) > 0)
+            run_commands(term);
+
+        if (SDL_GetPerformanceCounter() >= deadline)
+            break;
+    }
+
+    return ring_used(&g_pty_ring) > 0;
 }
 
-static void terminal_set_character(Ozterm* term, int16_t row, int16_t column, OztermCell * cell)
+static int parser_thread(void* data)
 {
-    //TODO: optimize by only updating individual characters not full screen
-    g_refresh_screen = 1;
+    Ozterm* term = data;
+
+    Uint64 frame_ticks = SDL_GetPerformanceFrequency() / g_refresh_rate;
+    Uint64 last_publish = 0;
+    Uint64 last_timing_copy = 0;
+    int flooding = 0;
+
+    while (!atomic_load(&g_parser_quit))
+    {
+        if (flooding)
+        {
+            // Still behind, keep parsing and only take the pending post
+            SDL_SemTryWait(g_parser_wake);
+        }
+        else if (ozterm_get_synchronized_output(term))
+        {
+            // The application may never end its update, wake up to let it time out
+            SDL_SemWaitTimeout(g_parser_wake, SYNCHRONIZED_POLL_MS);
+        }
+        else
+        {
+            SDL_SemWait(g_parser_wake);
+        }
+        atomic_store(&g_parser_wake_pending, 0);
+
+        Uint64 busy_start = SDL_GetPerformanceCounter();
+
+        run_commands(term);
+
+        // Parse at most a frame worth of time so commands and frames keep flowing
+        Uint64 now = SDL_GetPerformanceCounter();
+        flooding = consume_pty_ring(term, now + frame_ticks);
+
+        // Nobody sees intermediate states of a flood, skip their callbacks and damage
+        ozterm_set_fast_forward(term, flooding);
+
+        now = SDL_GetPerformanceCounter();
+        if (!flooding || now - last_publish >= frame_ticks)
+        {
+            ozterm_publish_snapshot(term);
+            last_publish = now;
+
+            // Nothing is published in the middle of a synchronized update
+            if (!ozterm_get_synchronized_output(term))
+                notify_frame();
+        }
+
+        // The histograms belong to this thread, the overlay reads a copy
+        if (atomic_load(&g_overlay_visible) && now - last_timing_copy >= SDL_GetPerformanceFrequency() * OVERLAY_WINDOW_MS / 1000)
+        {
+            SDL_LockMutex(g_timing_lock);
+            g_timing_valid = ozterm_get_timing(term, &g_timing_copy);
+            SDL_UnlockMutex(g_timing_lock);
+            last_timing_copy = now;
+        }
+
+        atomic_fetch_add(&g_parse_ticks, SDL_GetPerformanceCounter() - busy_start);
+
+        if (!flooding && atomic_load(&g_pty_closed) && ring_used(&g_pty_ring) == 0)
+        {
+            SDL_Event e;
+            memset(&e, 0, sizeof(e));
+            e.type = SDL_QUIT;
+            SDL_PushEvent(&e);
+            break;
+        }
+    }
+
+    return 0;
 }
 
-static void terminal_move_cursor(Ozterm* term, int16_t old_row, int16_t old_column, int16_t row, int16_t column)
+// Takes over the damage of a newly acquired snapshot
+static void take_snapshot(const OztermSnapshot* snapshot)
 {
-    //TODO: optimize by only updating cursor not full screen
+    g_snapshot = snapshot;
+
+    int16_t top, bottom;
+    int16_t lines = ozterm_snapshot_get_scroll_delta(snapshot, &top, &bottom);
+    if (lines != 0)
+        mark_scroll(top, bottom, lines);
+
+    int16_t row_count = ozterm_snapshot_get_row_count(snapshot);
+    for (int y = 0; y < row_count; ++y)
+    {
+        if (ozterm_snapshot_is_row_dirty(snapshot, y))
+            g_dirty_rows[y] = 1;
+    }
+
+    if (atomic_exchange(&g_palette_changed, 0))
+        mark_all_dirty();
+
+    // The cursor may have moved even without damage
     g_refresh_screen = 1;
 }
 
+// Benchmark aid: types a key every interval as if pressed
+static Uint32 inject_key_timer(Uint32 interval, void* data)
+{
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = SDL_TEXTINPUT;
+    e.text.text[0] = 'a';
+    SDL_PushEvent(&e);
+
+    return interval;
+}
+
+static Uint32 probe_timer(Uint32 interval, void* data)
+{
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = g_probe_event;
+    SDL_PushEvent(&e);
+
+    return interval;
+}
+
+// Types the next probe key once the last one is presented or given up on
+static void probe_tick()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    SDL_LockMutex(g_probe_lock);
+    if (g_probes.state != PROBE_IDLE && now - g_probes.event_time > SDL_GetPerformanceFrequency() * PROBE_TIMEOUT_MS / 1000)
+    {
+        atomic_store(&g_probe_key, 0);
+        g_probes.state = PROBE_IDLE;
+        g_probes.lost++;
+    }
+
+    int idle = g_probes.state == PROBE_IDLE;
+    int finished = g_probes.started == g_probes.target;
+    uint8_t key = PROBE_KEYS[g_probes.started % (sizeof(PROBE_KEYS) - 1)];
+    if (idle && !finished)
+    {
+        g_probes.state = PROBE_SENT;
+        g_probes.key = key;
+        // Until the parser takes it, so the timeout covers a full command ring
+        g_probes.event_time = now;
+        g_probes.started++;
+    }
+    SDL_UnlockMutex(g_probe_lock);
+
+    if (idle && finished)
+    {
+        SDL_Event e;
+        memset(&e, 0, sizeof(e));
+        e.type = SDL_QUIT;
+        SDL_PushEvent(&e);
+    }
+    else if (idle)
+    {
+        Command command = { .type = COMMAND_KEY, .modifier = OZTERM_KEYM_NONE, .key = key, .probe = 1 };
+        if (!push_command(&command))
+        {
+            SDL_LockMutex(g_probe_lock);
+            g_probes.state = PROBE_IDLE;
+            g_probes.started--;
+            SDL_UnlockMutex(g_probe_lock);
+        }
+    }
+}
+
+// Called right after presenting the snapshot numbered g_acquired_frame
+static void probe_presented()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double to_ms = 1e3 / SDL_GetPerformanceFrequency();
+
+    SDL_LockMutex(g_probe_lock);
+    // Snapshot numbers wrap, compare their distance
+    if (g_probes.state == PROBE_ECHOED && (int32_t)(g_acquired_frame - g_probes.frame) >= 0)
+    {
+        int i = g_probes.done++;
+        g_probes.queue_ms[i] = (g_probes.send_time - g_probes.event_time) * to_ms;
+        g_probes.echo_ms[i] = (g_probes.echo_time - g_probes.send_time) * to_ms;
+        g_probes.present_ms[i] = (now - g_probes.echo_time) * to_ms;
+        g_probes.total_ms[i] = (now - g_probes.send_time) * to_ms;
+        g_probes.state = PROBE_IDLE;
+    }
+    SDL_UnlockMutex(g_probe_lock);
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_percentiles(const char* name, double* values, int count)
+{
+    if (count == 0)
+        return;
+
+    qsort(values, count, sizeof(double), compare_doubles);
+
+    printf("%s_p50_ms=%.3f %s_p90_ms=%.3f %s_p99_ms=%.3f %s_max_ms=%.3f\n",
+        name, values[(count - 1) * 50 / 100], name, values[(count - 1) * 90 / 100],
+        name, values[(count - 1) * 99 / 100], name, values[count - 1]);
+}
+
+static void print_probes()
+{
+    printf("probes=%d lost=%d\n", g_probes.done, g_probes.lost);
+    print_percentiles("key_to_screen", g_probes.total_ms, g_probes.done);
+    print_percentiles("queue", g_probes.queue_ms, g_probes.done);
+    print_percentiles("echo", g_probes.echo_ms, g_probes.done);
+    print_percentiles("present", g_probes.present_ms, g_probes.done);
+}
+
+static void print_stats(Ozterm* term, Uint64 start_counter)
+{
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    double wall = (SDL_GetPerformanceCounter() - start_counter) / frequency;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    printf("wall_s=%.3f cpu_s=%.3f cpu_pct=%.2f\n", wall, cpu, wall > 0 ? 100.0 * cpu / wall : 0.0);
+    printf("wakeups=%llu wakeup_avg_us=%.1f wakeup_max_us=%.1f\n",
+        (unsigned long long)g_wakeup_count,
+        g_wakeup_count ? 1e6 * g_wakeup_total / frequency / g_wakeup_count : 0.0,
+        1e6 * g_wakeup_max / frequency);
+    printf("keys=%llu input_avg_us=%.1f input_max_us=%.1f\n",
+        (unsigned long long)g_input_count,
+        g_input_count ? 1e6 * g_input_total / frequency / g_input_count : 0.0,
+        1e6 * g_input_max / frequency);
+    printf("output_max_pending=%u output_stalls=%llu\n",
+        g_output_max_pending, (unsigned long long)g_output_stalls);
+
+    // Only with OZTERM_TIMING set
+    OztermTiming timing;
+    if (ozterm_get_timing(term, &timing))
+    {
+        uint64_t callback_total = 0;
+        for (int i = 0; i < OZTERM_CALLBACK_COUNT; ++i)
+        {
+            callback_total += timing.callbacks[i].total;
+        }
+
+        printf("chunks=%llu chunk_p50_us=%.1f chunk_p99_us=%.1f chunk_max_us=%.1f callback_pct=%.1f\n",
+            (unsigned long long)timing.chunk.count,
+            ozterm_histogram_percentile(&timing.chunk, 50) / 1e3, ozterm_histogram_percentile(&timing.chunk, 99) / 1e3,
+            timing.chunk.max / 1e3, timing.chunk.total ? 100.0 * callback_total / timing.chunk.total : 0.0);
+    }
+
+    // Only with make STATS=1
+    OztermStats stats;
+    if (ozterm_get_stats(term, &stats))
+    {
+        printf("parsed_bytes=%llu printable_bytes=%llu control_bytes=%llu unhandled=%llu scrolled_lines=%llu cells_written=%llu\n",
+            (unsigned long long)stats.bytes, (unsigned long long)stats.printable_bytes,
+            (unsigned long long)stats.control_bytes, (unsigned long long)stats.unhandled,
+            (unsigned long long)stats.scrolled_lines, (unsigned long long)stats.cells_written);
+    }
+}
+
+// Next chunk to parse as one frame, 0 at the end of the file
+static size_t next_bench_chunk(const uint8_t** cursor, const uint8_t* end, int recording, const uint8_t** chunk)
+{
+    if (!recording)
+    {
+        size_t size = MIN((size_t)(end - *cursor), (size_t)RENDER_BENCH_CHUNK);
+        *chunk = *cursor;
+        *cursor += size;
+        return size;
+    }
+
+    RecorderRecord record;
+    while (recorder_next_record(cursor, end, &record) > 0)
+    {
+        if (record.direction == OZTERM_RECORD_OUTPUT && record.size > 0)
+        {
+            *chunk = record.data;
+            return record.size;
+        }
+    }
+
+    return 0;
+}
+
+// Replays a file through the terminal on the calling thread and renders a frame
+// after every chunk, into the offscreen renderer set up by main(). Prints one
+// key=value line, with a checksum of the final pixels to compare renderer changes.
+static int run_render_benchmark(const char* path)
+{
+    size_t size;
+    uint8_t* data = recorder_load_file(path, &size);
+    if (!data)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if (size == 0)
+    {
+        fprintf(stderr, "%s: empty file\n", path);
+        free(data);
+        return 1;
+    }
+
+    int recording = recorder_is_recording(data, size);
+    const uint8_t* cursor = data + (recording ? RECORDER_HEADER_SIZE : 0);
+    const uint8_t* end = data + size;
+
+    SDL_Color white = {255, 255, 255, 255};
+    build_g_glyph_cache(g_renderer, g_font, white);
+    palette_init();
+
+    Ozterm* term = ozterm_create(ROWS, COLS);
+    ozterm_set_palette_callback(term, terminal_set_palette);
+    ozterm_enable_snapshots(term);
+    ozterm_publish_snapshot(term);
+    g_snapshot = ozterm_acquire_snapshot(term);
+    mark_all_dirty();
+
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    int frame_capacity = 1024;
+    double* frame_ms = malloc(frame_capacity * sizeof(double));
+    int frames = 0;
+    Uint64 bytes = 0, parse_ticks = 0, render_ticks = 0;
+    Uint64 draw_calls = 0, texture_binds = 0, rows = 0;
+
+    const uint8_t* chunk;
+    size_t chunk_size;
+    while ((chunk_size = next_bench_chunk(&cursor, end, recording, &chunk)) > 0)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        ozterm_have_read_from_master(term, chunk, (int32_t)chunk_size);
+        ozterm_publish_snapshot(term);
+        bytes += chunk_size;
+
+        const OztermSnapshot* snapshot = ozterm_acquire_snapshot(term);
+        if (snapshot)
+            take_snapshot(snapshot);
+
+        Uint64 render_start = SDL_GetPerformanceCounter();
+        parse_ticks += render_start - start;
+
+        if (!g_refresh_screen)
+            continue;
+
+        render_screen(g_renderer, g_font);
+        SDL_RenderPresent(g_renderer);
+        g_refresh_screen = 0;
+
+        Uint64 ticks = SDL_GetPerformanceCounter() - render_start;
+        render_ticks += ticks;
+        draw_calls += g_render_stats.draw_calls;
+        texture_binds += g_render_stats.texture_binds;
+        rows += g_render_stats.rows;
+
+        if (frames == frame_capacity)
+        {
+            frame_capacity *= 2;
+            frame_ms = realloc(frame_ms, frame_capacity * sizeof(double));
+        }
+        frame_ms[frames++] = 1e3 * ticks / frequency;
+    }
+
+    // FNV-1a of what ended up on screen, cursor and all
+    int width = COLS * g_font_width;
+    int height = ROWS * g_font_height;
+    uint32_t* pixels = malloc((size_t)width * height * sizeof(uint32_t));
+    SDL_RenderReadPixels(g_renderer, NULL, SDL_PIXELFORMAT_RGBA8888, pixels, width * sizeof(uint32_t));
+
+    uint64_t checksum = 14695981039346656037ULL;
+    const uint8_t* p = (const uint8_t*)pixels;
+    for (size_t i = 0; i < (size_t)width * height * sizeof(uint32_t); ++i)
+    {
+        checksum ^= p[i];
+        checksum *= 1099511628211ULL;
+    }
+
+    double render_s = render_ticks / frequency;
+    int count = frames > 0 ? frames : 1;
+    if (frames > 0)
+        qsort(frame_ms, frames, sizeof(double), compare_doubles);
+
+    printf("file=%s bytes=%llu frames=%d fps=%.1f ms_per_frame=%.3f frame_p50_ms=%.3f frame_p99_ms=%.3f frame_max_ms=%.3f"
+        " parse_ms=%.1f rows_per_frame=%.1f draw_calls_per_frame=%.1f texture_binds_per_frame=%.1f checksum=%016llx\n",
+        path, (unsigned long long)bytes, frames, render_s > 0 ? frames / render_s : 0.0, 1e3 * render_s / count,
+        frames ? frame_ms[(frames - 1) * 50 / 100] : 0.0, frames ? frame_ms[(frames - 1) * 99 / 100] : 0.0,
+        frames ? frame_ms[frames - 1] : 0.0, 1e3 * parse_ticks / frequency,
+        (double)rows / count, (double)draw_calls / count, (double)texture_binds / count,
+        (unsigned long long)checksum);
+
+    free(pixels);
+    free(frame_ms);
+    ozterm_destroy(term);
+    free(data);
+
+    return 0;
+}
+
 static void update_pty_winsize(int fd, int cols, int rows)
 {
     struct winsize ws =
@@ -333,9 +1509,14 @@ static void update_pty_winsize(int fd, int cols, int rows)
     ioctl(fd, TIOCSWINSZ, &ws);
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    SDL_Init(SDL_INIT_VIDEO);
+    // Render benchmark: no window, no child, needs no display
+    const char* render_bench = getenv("OZTERM_RENDER_BENCH");
+    if (render_bench)
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
     TTF_Init();
     
     g_font = TTF_OpenFont("fonts/DejaVuSansMono.ttf", FONT_SIZE);
@@ -347,22 +1528,59 @@ int main()
 
     TTF_SizeText(g_font, "M", &g_font_width, &g_font_height);  // "M" is usually the widest monospaced char
 
-    SDL_Window* win = SDL_CreateWindow("Ozterm", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, COLS * g_font_width, ROWS * g_font_height, 0);
-    g_renderer = SDL_CreateRenderer(win, -1, SDL_RENDERER_PRESENTVSYNC);
+    SDL_Window* win = NULL;
+    SDL_Surface* offscreen = NULL;
+    if (render_bench)
+    {
+        offscreen = SDL_CreateRGBSurfaceWithFormat(0, COLS * g_font_width, ROWS * g_font_height, 32, SDL_PIXELFORMAT_RGBA8888);
+        g_renderer = SDL_CreateSoftwareRenderer(offscreen);
+    }
+    else
+    {
+        win = SDL_CreateWindow("Ozterm", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, COLS * g_font_width, ROWS * g_font_height, 0);
+        g_renderer = SDL_CreateRenderer(win, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
+    }
+
+    g_framebuffer = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, COLS * g_font_width, ROWS * g_font_height);
+    g_framebuffer_back = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, COLS * g_font_width, ROWS * g_font_height);
+    SDL_SetTextureBlendMode(g_framebuffer, SDL_BLENDMODE_NONE);
+    SDL_SetTextureBlendMode(g_framebuffer_back, SDL_BLENDMODE_NONE);
+
+    if (render_bench)
+    {
+        int result = run_render_benchmark(render_bench);
+        SDL_DestroyTexture(g_framebuffer);
+        SDL_DestroyTexture(g_framebuffer_back);
+        SDL_DestroyRenderer(g_renderer);
+        SDL_FreeSurface(offscreen);
+        SDL_Quit();
+        return result;
+    }
 
     pid_t pid = forkpty(&g_master_fd, NULL, NULL, NULL);
 
     if (pid > 0)
     {
         update_pty_winsize(g_master_fd, COLS, ROWS);
+
+        // Writes are queued and flushed when the pty is writable, reads are polled
+        fcntl(g_master_fd, F_SETFL, fcntl(g_master_fd, F_GETFL) | O_NONBLOCK);
     }
     else if (pid == 0)
     {
         update_pty_winsize(STDOUT_FILENO, COLS, ROWS);
 
         setenv("TERM", "xterm-256color", 1);
-        execl("/bin/bash", "bash", NULL);
-        perror("execl");
+        if (argc > 1)
+        {
+            // ozterm [command [args...]], used by the benchmarks
+            execvp(argv[1], argv + 1);
+        }
+        else
+        {
+            execl("/bin/bash", "bash", NULL);
+        }
+        perror("exec");
         exit(1);
     }
 
@@ -370,9 +1588,9 @@ int main()
     SDL_Color white = {255, 255, 255, 255};
 
     int running = 1;
-    char buf[8192];
 
     build_g_glyph_cache(g_renderer, g_font, white);
+    palette_init();
 
     Terminal* terminal = malloc(sizeof(Terminal));
     g_terminal = terminal;
@@ -380,36 +1598,118 @@ int main()
 
     Ozterm * term = ozterm_create(ROWS, COLS);
     ozterm_set_write_to_master_callback(term, write_to_master);
-    ozterm_set_render_callbacks(term, terminal_refresh, terminal_set_character, terminal_move_cursor);
+    ozterm_set_palette_callback(term, terminal_set_palette);
+    ozterm_set_unhandled_callback(term, report_unhandled, UNHANDLED_REPORT_MS);
+
+    // Chunk and callback latency histograms, printed with OZTERM_STATS
+    if (getenv("OZTERM_TIMING"))
+        ozterm_set_timing(term, 1);
     ozterm_set_custom_data(term, terminal);
     terminal->term = term;
 
-    while (running)
+    const char* record_path = getenv("OZTERM_RECORD");
+    if (record_path)
     {
-        g_refresh_screen = 0;
+        g_recorder = recorder_open(record_path, ROWS, COLS);
+        if (g_recorder)
+            ozterm_set_record_callback(term, record_session);
+        else
+            perror(record_path);
+    }
 
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(g_master_fd, &fds);
-        struct timeval tv = {0, 0}; // 1ms
-        select(g_master_fd + 1, &fds, NULL, NULL, &tv);
+    // Rendering works from snapshots and their damage, no render callbacks needed
+    ozterm_enable_snapshots(term);
+    ozterm_publish_snapshot(term);
+    g_snapshot = ozterm_acquire_snapshot(term);
 
-        if (FD_ISSET(g_master_fd, &fds))
-        {
-            int len = read(g_master_fd, buf, sizeof(buf));
-            if (len >= 0)
-            {
-                ozterm_have_read_from_master(term, (uint8_t*)buf, len);
-            }
-        }
+    mark_all_dirty();
+
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+
+    // Floods are published at most once per display refresh
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(win), &mode) == 0 && mode.refresh_rate > 0)
+    {
+        g_refresh_rate = mode.refresh_rate;
+    }
 
+    g_frame_event = SDL_RegisterEvents(1);
+    g_overlay_event = SDL_RegisterEvents(1);
+    g_timing_lock = SDL_CreateMutex();
+    g_probe_event = SDL_RegisterEvents(1);
+    g_probe_lock = SDL_CreateMutex();
+    g_ring_space = SDL_CreateSemaphore(0);
+    g_parser_wake = SDL_CreateSemaphore(0);
+    ring_init(&g_pty_ring, PTY_RING_SIZE);
+    ring_init(&g_command_ring, COMMAND_RING_SIZE);
+    if (pipe(g_wake_pipe) != 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+    fcntl(g_wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(g_wake_pipe[1], F_SETFL, O_NONBLOCK);
+    queue_init(&g_output, OUTPUT_QUEUE_SIZE);
+    g_output_lock = SDL_CreateMutex();
+    queue_init(&g_text_queue, TEXT_QUEUE_SIZE);
+    g_text_lock = SDL_CreateMutex();
+    SDL_Thread* reader = SDL_CreateThread(pty_reader_thread, "pty_reader", NULL);
+    SDL_Thread* parser = SDL_CreateThread(parser_thread, "parser", term);
+
+    const char* inject_interval = getenv("OZTERM_INJECT_KEY_MS");
+    if (inject_interval)
+    {
+        SDL_AddTimer(atoi(inject_interval), inject_key_timer, NULL);
+    }
+
+    const char* probe_count = getenv("OZTERM_LATENCY_PROBES");
+    if (probe_count && atoi(probe_count) > 0)
+    {
+        g_probes.target = atoi(probe_count);
+        g_probes.queue_ms = malloc(g_probes.target * sizeof(double));
+        g_probes.echo_ms = malloc(g_probes.target * sizeof(double));
+        g_probes.present_ms = malloc(g_probes.target * sizeof(double));
+        g_probes.total_ms = malloc(g_probes.target * sizeof(double));
+        SDL_AddTimer(PROBE_INTERVAL_MS, probe_timer, NULL);
+    }
+
+    while (running)
+    {
         SDL_Event e;
-        while (SDL_PollEvent(&e))
+        if (!SDL_WaitEvent(&e))
+            break;
+
+        // Handle everything pending before rendering once
+        do
         {
             if (e.type == SDL_QUIT)
             {
                 running = 0;
             }
+            else if (e.type == g_frame_event)
+            {
+                atomic_store(&g_frame_pending, 0);
+
+                const OztermSnapshot* snapshot = ozterm_acquire_snapshot(term);
+                if (snapshot)
+                {
+                    take_snapshot(snapshot);
+                    g_acquired_frame = ozterm_snapshot_get_sequence(snapshot);
+                }
+            }
+            else if (e.type == g_probe_event)
+            {
+                probe_tick();
+            }
+            else if (e.type == g_overlay_event)
+            {
+                g_refresh_screen = 1;
+            }
+            else if (e.type == SDL_RENDER_TARGETS_RESET)
+            {
+                // Target texture contents were lost
+                mark_all_dirty();
+            }
             else if (e.type == SDL_KEYDOWN)
             {
                 uint8_t terminal_key = OZTERM_KEY_NONE;
@@ -424,6 +1724,25 @@ int main()
                 if (mod & KMOD_CTRL)   modifier |= OZTERM_KEYM_CTRL;
                 if (mod & KMOD_ALT)    modifier |= OZTERM_KEYM_ALT;
 
+                if (sdl_key == SDLK_p && (mod & KMOD_CTRL) && (mod & KMOD_SHIFT))
+                {
+                    toggle_overlay();
+                    continue;
+                }
+
+                // Ctrl+Shift+V or Shift+Insert pastes the clipboard
+                if ((sdl_key == SDLK_v && (mod & KMOD_CTRL) && (mod & KMOD_SHIFT)) ||
+                    (sdl_key == SDLK_INSERT && (mod & KMOD_SHIFT)))
+                {
+                    char* clipboard = SDL_GetClipboardText();
+                    if (clipboard)
+                    {
+                        send_text_command(COMMAND_PASTE, clipboard, strlen(clipboard));
+                        SDL_free(clipboard);
+                    }
+                    continue;
+                }
+
                 switch (sdl_key)
                 {
                     case SDLK_RETURN:   terminal_key = OZTERM_KEY_RETURN; break;
@@ -469,34 +1788,34 @@ int main()
 
                 if (terminal_key != OZTERM_KEY_NONE)
                 {
-                    ozterm_send_key(term, modifier, terminal_key);
+                    send_command(COMMAND_KEY, modifier, terminal_key, 0);
                 }
             }
             else if (e.type == SDL_TEXTINPUT)
             {
                 if (!(SDL_GetModState() & (KMOD_CTRL | KMOD_ALT)))
                 {
-                    ozterm_send_key(term, OZTERM_KEYM_NONE, e.text.text[0]);
+                    send_text_command(COMMAND_TEXT, e.text.text, strlen(e.text.text));
                 }
             }
             else if (e.type == SDL_MOUSEWHEEL)
             {
                 if (e.wheel.y > 0)
-                    ozterm_scroll(term, ozterm_get_scroll(term) + 3);
+                    send_command(COMMAND_SCROLL_BY, 0, 0, 3);
                 else if (e.wheel.y < 0)
-                    ozterm_scroll(term, ozterm_get_scroll(term) - 3);
+                    send_command(COMMAND_SCROLL_BY, 0, 0, -3);
             }
             else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT)
             {
                 int mouse_x = e.button.x;
                 int mouse_y = e.button.y;
 
-                int scrollbar_x = ozterm_get_column_count(terminal->term) * g_font_width - SCROLLBAR_WIDTH - SCROLLBAR_MARGIN;
+                int scrollbar_x = ozterm_snapshot_get_column_count(g_snapshot) * g_font_width - SCROLLBAR_WIDTH - SCROLLBAR_MARGIN;
                 if (mouse_x >= scrollbar_x)
                 {
                     terminal->scrollbar_dragging = 1;
                     terminal->scrollbar_drag_start_y = mouse_y;
-                    terminal->scrollbar_scroll_start_offset = ozterm_get_scroll(terminal->term);
+                    terminal->scrollbar_scroll_start_offset = ozterm_snapshot_get_scroll(g_snapshot);
                 }
             }
             else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
@@ -505,32 +1824,89 @@ int main()
             }
             else if (e.type == SDL_MOUSEMOTION && terminal->scrollbar_dragging)
             {
-                int total_scroll = ozterm_get_scroll_count(terminal->term);
+                int total_scroll = ozterm_snapshot_get_scroll_count(g_snapshot);
                 if (total_scroll > 0)
                 {
                     int delta_y = e.motion.y - terminal->scrollbar_drag_start_y;
 
-                    int win_height = ozterm_get_row_count(terminal->term) * g_font_height;
-                    int height = win_height - get_scrollbar_height(terminal->term);
+                    int win_height = ozterm_snapshot_get_row_count(g_snapshot) * g_font_height;
+                    int height = win_height - get_scrollbar_height(g_snapshot);
                     float ratio = (float)delta_y / (float)height;
 
                     int new_offset = terminal->scrollbar_scroll_start_offset + (int)(-ratio * total_scroll);
                     if (new_offset < 0) new_offset = 0;
                     if (new_offset > total_scroll) new_offset = total_scroll;
 
-                    ozterm_scroll(terminal->term, new_offset);
+                    send_command(COMMAND_SCROLL_TO, 0, 0, new_offset);
                 }
             }
-        }
+        } while (running && SDL_PollEvent(&e));
 
         if (g_refresh_screen)
         {
+            Uint64 render_start = SDL_GetPerformanceCounter();
             render_screen(g_renderer, g_font);
+
+            if (g_overlay.visible)
+            {
+                overlay_add_frame(SDL_GetPerformanceCounter() - render_start);
+                draw_overlay(g_renderer);
+            }
+
             SDL_RenderPresent(g_renderer);
+            g_refresh_screen = 0;
+
+            if (g_probes.target > 0)
+                probe_presented();
         }
     }
 
+    atomic_store(&g_parser_quit, 1);
+    SDL_SemPost(g_parser_wake);
+    SDL_WaitThread(parser, NULL);
+    ozterm_report_unhandled(term);
+
+    if (g_recorder)
+    {
+        uint64_t dropped = recorder_close(g_recorder);
+        if (dropped > 0)
+            fprintf(stderr, "recording: %llu records dropped\n", (unsigned long long)dropped);
+    }
+
+    atomic_store(&g_reader_quit, 1);
+    write(g_wake_pipe[1], "", 1);
+    SDL_SemPost(g_ring_space);
+    SDL_WaitThread(reader, NULL);
+    close(g_wake_pipe[0]);
+    close(g_wake_pipe[1]);
+    SDL_DestroySemaphore(g_ring_space);
+    SDL_DestroySemaphore(g_parser_wake);
+    ring_destroy(&g_pty_ring);
+    ring_destroy(&g_command_ring);
+    SDL_DestroyMutex(g_output_lock);
+    queue_destroy(&g_output);
+    SDL_DestroyMutex(g_text_lock);
+    SDL_DestroyMutex(g_timing_lock);
+    SDL_DestroyMutex(g_probe_lock);
+    queue_destroy(&g_text_queue);
+
+    if (getenv("OZTERM_STATS"))
+    {
+        print_stats(term, start_counter);
+    }
+
+    if (g_probes.target > 0)
+    {
+        print_probes();
+        free(g_probes.queue_ms);
+        free(g_probes.echo_ms);
+        free(g_probes.present_ms);
+        free(g_probes.total_ms);
+    }
+
     close(g_master_fd);
+    SDL_DestroyTexture(g_framebuffer);
+    SDL_DestroyTexture(g_framebuffer_back);
     SDL_Quit();
     return 0;
 }
@@ -29,6 +29,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Static tracepoints for perf and bpftrace, provider "ozterm". With <sys/sdt.h> (systemtap-sdt-dev)
+// each is a nop and an ELF note until a tracer attaches; without it they compile to nothing.
+#if defined(__has_include) && !defined(OZTERM_DISABLE_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define OZTERM_HAVE_PROBES
+#endif
+#endif
 
 #include "ozterm.h"
 
@@ -42,6 +53,62 @@ typedef struct OztermScreen
     uint8_t attr_inverse;
 } OztermScreen;
 
+// Rows changed since the last publish; applied after blitting scroll_lines
+typedef struct OztermDamage
+{
+    uint8_t* rows;
+    int16_t scroll_top;
+    int16_t scroll_bottom;
+    int16_t scroll_lines;
+} OztermDamage;
+
+typedef struct OztermSnapshot
+{
+    OztermCell* buffer;
+    int16_t row_count;
+    int16_t column_count;
+    int16_t cursor_row;
+    int16_t cursor_column;
+    int16_t scroll_offset;
+    int16_t scrollback_count;
+    OztermColor fg_color_default;
+    OztermColor bg_color_default;
+    OztermDamage damage;
+    uint32_t sequence;
+} OztermSnapshot;
+
+typedef enum OztermParseState
+{
+    STATE_NORMAL,
+    STATE_ESC,
+    STATE_CSI,
+    STATE_OSC,
+    STATE_G0,
+    STATE_G1,
+    STATE_HASH
+} OztermParseState;
+
+// Escape sequence state, kept per terminal so parsing can stop anywhere
+typedef struct OztermParser
+{
+    OztermParseState state;
+    char param_buf[32];
+    int param_len;
+    char seq_buf[64];
+    int seq_len;
+    char osc_buf[64];
+    int osc_index;
+    char final_byte;
+    char intermediate;
+    uint8_t is_private;
+} OztermParser;
+
+#define SNAPSHOT_COUNT 3
+#define SNAPSHOT_FRESH 4
+
+// Distinct unhandled sequences kept between two reports
+#define UNHANDLED_TABLE_SIZE 32
+
 typedef struct Ozterm
 {
     OztermScreen* screen_main;
@@ -57,7 +124,10 @@ typedef struct Ozterm
     OztermColor fg_color_default;
     OztermColor bg_color_default;
     uint8_t DECCKM;
+    uint8_t bracketed_paste;
+    OztermParser parser;
     void* custom_data;
+    OztermAllocator allocator;
     OztermCell** scrollback;     // Array of pointers to lines
     int16_t scrollback_head;         // Next line to write
     int16_t scrollback_count;        // Total filled lines
@@ -66,12 +136,78 @@ typedef struct Ozterm
     OztermSetCharacter set_character_function;
     OztermMoveCursor move_cursor_function;
     OztermWriteToMaster write_to_master_function;
+    OztermScrollRegion scroll_function;
+    OztermSetPalette palette_function;
+    OztermRecord record_function;
+    OztermReportUnhandled unhandled_function;
+    // Unhandled sequences since the last report
+    OztermUnhandled unhandled[UNHANDLED_TABLE_SIZE];
+    int32_t unhandled_count;
+    uint32_t unhandled_others;
+    uint64_t unhandled_interval;
+    uint64_t unhandled_reported;
+    // Only allocated while timing is enabled
+    OztermTiming* timing;
+    // Triple buffer: the parser fills snapshot_back, the renderer owns
+    // snapshot_front, snapshot_latest is swapped atomically between them
+    OztermSnapshot* snapshots;
+    OztermDamage damage;
+    uint8_t fast_forward;
+    // Mode 2026: screen updates are held until the application ends its frame
+    uint8_t synchronized_output;
+    uint64_t synchronized_output_start;
+    int snapshot_back;
+    int snapshot_front;
+    atomic_int snapshot_latest;
+    uint32_t snapshot_sequence;
+#ifdef OZTERM_ENABLE_STATS
+    OztermStats stats;
+#endif
 } Ozterm;
 
 #define TAB_WIDTH 8
 
 #define SCROLLBACK_LINES 1024
 
+// Largest single OztermWriteToMaster for sent text
+#define SEND_CHUNK_SIZE 4096
+
+// Bytes parsed between clock reads when a time budget is given
+#define BUDGET_CHECK_INTERVAL 4096
+
+// A synchronized update that is never ended is shown anyway after this long
+#define SYNCHRONIZED_OUTPUT_TIMEOUT_US 150000
+
+// Counters are only compiled in with OZTERM_ENABLE_STATS, the statement is dropped otherwise
+#ifdef OZTERM_ENABLE_STATS
+#define OZTERM_STAT(statement) (terminal->stats.statement)
+#else
+#define OZTERM_STAT(statement) ((void)0)
+#endif
+
+#ifdef OZTERM_HAVE_PROBES
+#define OZTERM_PROBE1(name, a) DTRACE_PROBE1(ozterm, name, a)
+#define OZTERM_PROBE2(name, a, b) DTRACE_PROBE2(ozterm, name, a, b)
+#define OZTERM_PROBE4(name, a, b, c, d) DTRACE_PROBE4(ozterm, name, a, b, c, d)
+#else
+#define OZTERM_PROBE1(name, a) ((void)0)
+#define OZTERM_PROBE2(name, a, b) ((void)0)
+#define OZTERM_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+// Host code runs between the callback probes, so tracers can tell its time from the parser's
+#define OZTERM_CALLBACK(kind, counter, call) \
+    do \
+    { \
+        OZTERM_STAT(counter++); \
+        OZTERM_PROBE2(callback__begin, terminal, kind); \
+        uint64_t callback_start = terminal->timing ? ozterm_now_nanoseconds() : 0; \
+        call; \
+        if (terminal->timing) \
+            ozterm_histogram_add(&terminal->timing->callbacks[kind], ozterm_now_nanoseconds() - callback_start); \
+        OZTERM_PROBE2(callback__end, terminal, kind); \
+    } while (0)
+
 // C('A') == Control-A
 #define C(x) (x - '@')
 
@@ -92,33 +228,110 @@ static void ozterm_insert_lines(Ozterm* terminal, int from_row, int count);
 static void ozterm_delete_lines(Ozterm* terminal, int from_row, int count);
 static void ozterm_switch_to_alt_screen(Ozterm* terminal);
 static void ozterm_restore_main_screen(Ozterm* terminal);
-
-static void * malloc_impl(size_t size)
+static void ozterm_notify_scroll(Ozterm* terminal, int16_t top, int16_t bottom, int16_t lines);
+static void ozterm_notify_refresh(Ozterm* terminal);
+static void ozterm_notify_character(Ozterm* terminal, int16_t row, int16_t column, OztermCell* cell);
+static void ozterm_damage_all(Ozterm* terminal, OztermDamage* damage);
+static void ozterm_damage_scroll(Ozterm* terminal, OztermDamage* damage, int16_t top, int16_t bottom, int16_t lines);
+static void ozterm_handle_osc(Ozterm* terminal, const char* osc);
+static void ozterm_set_synchronized_output(Ozterm* terminal, uint8_t enabled);
+static void ozterm_check_synchronized_output_timeout(Ozterm* terminal);
+static uint64_t ozterm_now_microseconds();
+static uint64_t ozterm_now_nanoseconds();
+static void ozterm_histogram_add(OztermHistogram* histogram, uint64_t value);
+static void ozterm_count_unhandled(Ozterm* terminal);
+static void ozterm_check_unhandled_report(Ozterm* terminal);
+
+static void * ozterm_default_malloc(void* context, size_t size)
 {
     return malloc(size);
 }
 
-static void free_impl(void * address)
+static void ozterm_default_free(void* context, void * address)
 {
     free(address);
 }
 
+// The tracking allocator keeps the size of each block in front of it,
+// in a header that keeps the block aligned like malloc does
+#define OZTERM_TRACKING_HEADER 16
+
+static void * ozterm_tracking_malloc(void* context, size_t size)
+{
+    OztermAllocationStats* stats = context;
+
+    uint8_t* block = malloc(size + OZTERM_TRACKING_HEADER);
+    if (!block)
+        return NULL;
+
+    memcpy(block, &size, sizeof(size));
+
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_bytes)
+        stats->peak_bytes = stats->live_bytes;
+    stats->allocations++;
+
+    return block + OZTERM_TRACKING_HEADER;
+}
+
+static void ozterm_tracking_free(void* context, void * address)
+{
+    OztermAllocationStats* stats = context;
+
+    uint8_t* block = (uint8_t*)address - OZTERM_TRACKING_HEADER;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+
+    stats->live_bytes -= size;
+    stats->frees++;
+
+    free(block);
+}
+
+static void * malloc_impl(Ozterm* terminal, size_t size)
+{
+    return terminal->allocator.malloc_func(terminal->allocator.context, size);
+}
+
+static void free_impl(Ozterm* terminal, void * address)
+{
+    if (address)
+        terminal->allocator.free_func(terminal->allocator.context, address);
+}
+
+void ozterm_tracking_allocator_init(OztermAllocator* allocator, OztermAllocationStats* stats)
+{
+    memset(stats, 0, sizeof(OztermAllocationStats));
+    allocator->malloc_func = ozterm_tracking_malloc;
+    allocator->free_func = ozterm_tracking_free;
+    allocator->context = stats;
+}
 
 Ozterm* ozterm_create(uint16_t row_count, uint16_t column_count)
 {
-    Ozterm* terminal = malloc_impl(sizeof(Ozterm));
+    return ozterm_create_with_allocator(row_count, column_count, NULL);
+}
+
+Ozterm* ozterm_create_with_allocator(uint16_t row_count, uint16_t column_count, const OztermAllocator* allocator)
+{
+    OztermAllocator defaults = { ozterm_default_malloc, ozterm_default_free, NULL };
+    if (!allocator)
+        allocator = &defaults;
+
+    Ozterm* terminal = allocator->malloc_func(allocator->context, sizeof(Ozterm));
     memset((uint8_t*)terminal, 0, sizeof(Ozterm));
+    terminal->allocator = *allocator;
 
-    terminal->screen_main = malloc_impl(sizeof(OztermScreen));
+    terminal->screen_main = malloc_impl(terminal, sizeof(OztermScreen));
     memset((uint8_t*)terminal->screen_main, 0, sizeof(OztermScreen));
-    terminal->screen_main->buffer = malloc_impl(row_count * column_count * sizeof(OztermCell));
+    terminal->screen_main->buffer = malloc_impl(terminal, row_count * column_count * sizeof(OztermCell));
     memset((uint8_t*)terminal->screen_main->buffer, 0, row_count * column_count * sizeof(OztermCell));
     terminal->screen_main->cursor_column = 0;
     terminal->screen_main->cursor_row = 0;
 
-    terminal->screen_alternative = malloc_impl(sizeof(OztermScreen));
+    terminal->screen_alternative = malloc_impl(terminal, sizeof(OztermScreen));
     memset((uint8_t*)terminal->screen_alternative, 0, sizeof(OztermScreen));
-    terminal->screen_alternative->buffer = malloc_impl(row_count * column_count * sizeof(OztermCell));
+    terminal->screen_alternative->buffer = malloc_impl(terminal, row_count * column_count * sizeof(OztermCell));
     memset((uint8_t*)terminal->screen_alternative->buffer, 0, row_count * column_count * sizeof(OztermCell));
     terminal->screen_alternative->cursor_column = 0;
     terminal->screen_alternative->cursor_row = 0;
@@ -132,12 +345,14 @@ Ozterm* ozterm_create(uint16_t row_count, uint16_t column_count)
     terminal->scroll_top = 0;
     terminal->scroll_bottom = terminal->row_count - 1;
     terminal->fg_color_default.index = 7;
+    terminal->fg_color_default.use_default = OZTERM_COLOR_DEFAULT_FG;
     terminal->bg_color_default.index = 0;
+    terminal->bg_color_default.use_default = OZTERM_COLOR_DEFAULT_BG;
 
-    terminal->scrollback = malloc_impl(sizeof(OztermCell*) * SCROLLBACK_LINES);
+    terminal->scrollback = malloc_impl(terminal, sizeof(OztermCell*) * SCROLLBACK_LINES);
     for (int i = 0; i < SCROLLBACK_LINES; ++i)
     {
-        terminal->scrollback[i] = malloc_impl(sizeof(OztermCell) * terminal->column_count);
+        terminal->scrollback[i] = malloc_impl(terminal, sizeof(OztermCell) * terminal->column_count);
         memset(terminal->scrollback[i], 0, sizeof(OztermCell) * terminal->column_count);
     }
     terminal->scrollback_head = 0;
@@ -154,17 +369,32 @@ Ozterm* ozterm_create(uint16_t row_count, uint16_t column_count)
 
 void ozterm_destroy(Ozterm* terminal)
 {
+    if (terminal->snapshots)
+    {
+        for (int i = 0; i < SNAPSHOT_COUNT; ++i)
+        {
+            free_impl(terminal, terminal->snapshots[i].buffer);
+            free_impl(terminal, terminal->snapshots[i].damage.rows);
+        }
+        free_impl(terminal, terminal->snapshots);
+        free_impl(terminal, terminal->damage.rows);
+    }
+
     for (int i = 0; i < SCROLLBACK_LINES; ++i)
     {
-        free_impl(terminal->scrollback[i]);
+        free_impl(terminal, terminal->scrollback[i]);
     }
-    free_impl(terminal->scrollback);
+    free_impl(terminal, terminal->scrollback);
+    free_impl(terminal, terminal->timing);
+
+    free_impl(terminal, terminal->screen_main->buffer);
+    free_impl(terminal, terminal->screen_main);
+    free_impl(terminal, terminal->screen_alternative->buffer);
+    free_impl(terminal, terminal->screen_alternative);
 
-    free_impl(terminal->screen_main->buffer);
-    free_impl(terminal->screen_main);
-    free_impl(terminal->screen_alternative->buffer);
-    free_impl(terminal->screen_alternative);
-    free_impl(terminal);
+    // The allocator lives in the terminal being freed
+    OztermAllocator allocator = terminal->allocator;
+    allocator.free_func(allocator.context, terminal);
 }
 
 void ozterm_clear_full(Ozterm* terminal)
@@ -188,6 +418,163 @@ void ozterm_set_render_callbacks(Ozterm* terminal, OztermRefresh refresh_func, O
     terminal->move_cursor_function = cursor_func;
 }
 
+void ozterm_set_scroll_callback(Ozterm* terminal, OztermScrollRegion scroll_func)
+{
+    terminal->scroll_function = scroll_func;
+}
+
+void ozterm_set_palette_callback(Ozterm* terminal, OztermSetPalette palette_func)
+{
+    terminal->palette_function = palette_func;
+}
+
+void ozterm_set_record_callback(Ozterm* terminal, OztermRecord record_func)
+{
+    terminal->record_function = record_func;
+}
+
+void ozterm_set_timing(Ozterm* terminal, uint8_t enabled)
+{
+    if (enabled)
+    {
+        if (!terminal->timing)
+            terminal->timing = malloc_impl(terminal, sizeof(OztermTiming));
+        memset(terminal->timing, 0, sizeof(OztermTiming));
+    }
+    else
+    {
+        free_impl(terminal, terminal->timing);
+        terminal->timing = NULL;
+    }
+}
+
+uint8_t ozterm_get_timing(Ozterm* terminal, OztermTiming* timing)
+{
+    if (!terminal->timing)
+    {
+        memset(timing, 0, sizeof(OztermTiming));
+        return 0;
+    }
+
+    *timing = *terminal->timing;
+    return 1;
+}
+
+//values below 4 get a bucket each, then 4 buckets per power of two
+static int ozterm_histogram_bucket(uint64_t value)
+{
+    if (value < 4)
+        return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int bucket = (msb - 1) * 4 + (int)((value >> (msb - 2)) & 3);
+
+    return bucket < OZTERM_HISTOGRAM_BUCKETS ? bucket : OZTERM_HISTOGRAM_BUCKETS - 1;
+}
+
+static uint64_t ozterm_histogram_bucket_limit(int bucket)
+{
+    if (bucket < 4)
+        return bucket;
+
+    int msb = bucket / 4 + 1;
+    uint64_t low = (uint64_t)(4 + bucket % 4) << (msb - 2);
+
+    return low + ((uint64_t)1 << (msb - 2)) - 1;
+}
+
+static void ozterm_histogram_add(OztermHistogram* histogram, uint64_t value)
+{
+    histogram->count++;
+    histogram->total += value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->buckets[ozterm_histogram_bucket(value)]++;
+}
+
+uint64_t ozterm_histogram_percentile(const OztermHistogram* histogram, double percentile)
+{
+    if (histogram->count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(histogram->count * percentile / 100.0 + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < OZTERM_HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t limit = ozterm_histogram_bucket_limit(i);
+            return limit < histogram->max ? limit : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+void ozterm_set_unhandled_callback(Ozterm* terminal, OztermReportUnhandled report_func, uint32_t interval_milliseconds)
+{
+    terminal->unhandled_function = report_func;
+    terminal->unhandled_interval = (uint64_t)interval_milliseconds * 1000;
+    terminal->unhandled_reported = ozterm_now_microseconds();
+}
+
+void ozterm_report_unhandled(Ozterm* terminal)
+{
+    if (terminal->unhandled_count == 0)
+        return;
+
+    if (terminal->unhandled_function)
+        terminal->unhandled_function(terminal, terminal->unhandled, terminal->unhandled_count, terminal->unhandled_others);
+
+    terminal->unhandled_count = 0;
+    terminal->unhandled_others = 0;
+    terminal->unhandled_reported = ozterm_now_microseconds();
+}
+
+static void ozterm_count_unhandled(Ozterm* terminal)
+{
+    OztermParser* parser = &terminal->parser;
+    int32_t first_param = parser->param_buf[0] && parser->param_buf[0] != ';' ? atoi(parser->param_buf) : -1;
+
+    for (int32_t i = 0; i < terminal->unhandled_count; ++i)
+    {
+        OztermUnhandled* entry = &terminal->unhandled[i];
+        if (entry->final_byte == parser->final_byte && entry->intermediate == parser->intermediate &&
+            entry->is_private == parser->is_private && entry->first_param == first_param)
+        {
+            entry->count++;
+            return;
+        }
+    }
+
+    if (terminal->unhandled_count == UNHANDLED_TABLE_SIZE)
+    {
+        terminal->unhandled_others++;
+        return;
+    }
+
+    OztermUnhandled* entry = &terminal->unhandled[terminal->unhandled_count++];
+    entry->is_private = parser->is_private;
+    entry->intermediate = parser->intermediate;
+    entry->final_byte = parser->final_byte;
+    entry->first_param = first_param;
+    entry->count = 1;
+}
+
+//the clock is only read while something is waiting to be reported
+static void ozterm_check_unhandled_report(Ozterm* terminal)
+{
+    if (terminal->unhandled_count > 0 && terminal->unhandled_function &&
+        ozterm_now_microseconds() - terminal->unhandled_reported >= terminal->unhandled_interval)
+    {
+        ozterm_report_unhandled(terminal);
+    }
+}
+
 void ozterm_set_custom_data(Ozterm* terminal, void* custom_data)
 {
     terminal->custom_data = custom_data;
@@ -283,10 +670,50 @@ void ozterm_scroll(Ozterm* terminal, int16_t scroll_offset)
         scroll_offset = 0;
     }
 
+    //view moving back into history shifts the visible content down
+    int16_t lines = terminal->scroll_offset - scroll_offset;
+
     terminal->scroll_offset = scroll_offset;
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    if (terminal->fast_forward)
+        return;
+
+    if (terminal->snapshots && lines != 0)
+        ozterm_damage_scroll(terminal, &terminal->damage, 0, terminal->row_count - 1, lines);
+
+    //held like region scrolls, the refresh at the end of the update covers it
+    if (terminal->synchronized_output)
+        return;
+
+    if (terminal->scroll_function)
+    {
+        if (lines != 0)
+        {
+            OZTERM_CALLBACK(OZTERM_CALLBACK_SCROLL, scroll_callbacks, terminal->scroll_function(terminal, 0, terminal->row_count - 1, lines));
+        }
+    }
+    else if (terminal->refresh_function)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_REFRESH, refresh_callbacks, terminal->refresh_function(terminal));
+    }
+}
+
+uint8_t ozterm_get_stats(Ozterm* terminal, OztermStats* stats)
+{
+#ifdef OZTERM_ENABLE_STATS
+    *stats = terminal->stats;
+    return 1;
+#else
+    memset(stats, 0, sizeof(OztermStats));
+    return 0;
+#endif
+}
+
+void ozterm_reset_stats(Ozterm* terminal)
+{
+#ifdef OZTERM_ENABLE_STATS
+    memset(&terminal->stats, 0, sizeof(OztermStats));
+#endif
 }
 
 int16_t ozterm_get_scroll(Ozterm* terminal)
@@ -303,34 +730,380 @@ static void write_to_master(Ozterm* terminal, const char* data, int32_t size)
 {
     if (terminal->write_to_master_function && size > 0)
     {
-        terminal->write_to_master_function(terminal, (uint8_t*)data, size);
+        OZTERM_CALLBACK(OZTERM_CALLBACK_WRITE_TO_MASTER, write_to_master_callbacks, terminal->write_to_master_function(terminal, (uint8_t*)data, size));
+    }
+}
+
+//user input, as opposed to replies generated by the parser
+static void write_input_to_master(Ozterm* terminal, const uint8_t* data, int32_t size)
+{
+    if (terminal->record_function && size > 0)
+    {
+        terminal->record_function(terminal, OZTERM_RECORD_INPUT, data, size);
+    }
+
+    write_to_master(terminal, (const char*)data, size);
+}
+
+static void ozterm_damage_all(Ozterm* terminal, OztermDamage* damage)
+{
+    memset(damage->rows, 1, terminal->row_count);
+    damage->scroll_lines = 0;
+}
+
+int16_t ozterm_shift_dirty_rows(uint8_t* rows, int16_t top, int16_t bottom, int16_t pending, int16_t lines)
+{
+    int height = bottom - top + 1;
+    int total = pending + lines;
+
+    if (lines >= height || lines <= -height || total >= height || total <= -height)
+    {
+        memset(rows + top, 1, height);
+        return 0;
+    }
+
+    // dirty rows travel with their content, exposed rows become dirty
+    if (lines > 0)
+    {
+        memmove(rows + top, rows + top + lines, height - lines);
+        memset(rows + bottom - lines + 1, 1, lines);
+    }
+    else if (lines < 0)
+    {
+        memmove(rows + top - lines, rows + top, height + lines);
+        memset(rows + top, 1, -lines);
     }
+
+    return total;
+}
+
+static void ozterm_damage_scroll(Ozterm* terminal, OztermDamage* damage, int16_t top, int16_t bottom, int16_t lines)
+{
+    if (damage->scroll_lines != 0 && (top != damage->scroll_top || bottom != damage->scroll_bottom))
+    {
+        // only one blit is described, another region means redraw
+        ozterm_damage_all(terminal, damage);
+        return;
+    }
+
+    damage->scroll_top = top;
+    damage->scroll_bottom = bottom;
+    damage->scroll_lines = ozterm_shift_dirty_rows(damage->rows, top, bottom, damage->scroll_lines, lines);
+}
+
+//newer is applied on top of older, the result is in older
+static void ozterm_damage_merge(Ozterm* terminal, OztermDamage* older, const OztermDamage* newer)
+{
+    if (newer->scroll_lines != 0)
+        ozterm_damage_scroll(terminal, older, newer->scroll_top, newer->scroll_bottom, newer->scroll_lines);
+
+    for (int row = 0; row < terminal->row_count; ++row)
+    {
+        older->rows[row] |= newer->rows[row];
+    }
+}
+
+static void ozterm_notify_refresh(Ozterm* terminal)
+{
+    if (terminal->fast_forward)
+        return;
+
+    if (terminal->snapshots)
+        ozterm_damage_all(terminal, &terminal->damage);
+
+    if (terminal->refresh_function && !terminal->synchronized_output)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_REFRESH, refresh_callbacks, terminal->refresh_function(terminal));
+    }
+}
+
+static void ozterm_notify_character(Ozterm* terminal, int16_t row, int16_t column, OztermCell* cell)
+{
+    if (terminal->fast_forward)
+        return;
+
+    //while viewing scrollback the row is shown further down, if at all
+    int16_t visible_row = row + terminal->scroll_offset;
+
+    if (terminal->snapshots && visible_row < terminal->row_count)
+        terminal->damage.rows[visible_row] = 1;
+
+    if (terminal->set_character_function && !terminal->synchronized_output)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_SET_CHARACTER, set_character_callbacks, terminal->set_character_function(terminal, row, column, cell));
+    }
+}
+
+static void ozterm_notify_scroll(Ozterm* terminal, int16_t top, int16_t bottom, int16_t lines)
+{
+    OZTERM_STAT(scrolls++);
+    OZTERM_STAT(scrolled_lines += lines > 0 ? lines : -lines);
+
+    if (terminal->fast_forward)
+        return;
+
+    //while viewing scrollback the visible rows are not the active buffer, so redraw all
+    if (terminal->scroll_offset != 0)
+    {
+        ozterm_notify_refresh(terminal);
+        return;
+    }
+
+    if (terminal->snapshots)
+        ozterm_damage_scroll(terminal, &terminal->damage, top, bottom, lines);
+
+    //the whole batch is reported as one refresh when the update ends
+    if (terminal->synchronized_output)
+        return;
+
+    if (terminal->scroll_function)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_SCROLL, scroll_callbacks, terminal->scroll_function(terminal, top, bottom, lines));
+    }
+    else if (terminal->refresh_function)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_REFRESH, refresh_callbacks, terminal->refresh_function(terminal));
+    }
+}
+
+void ozterm_set_fast_forward(Ozterm* terminal, uint8_t enabled)
+{
+    if (terminal->fast_forward == enabled)
+        return;
+
+    terminal->fast_forward = enabled;
+
+    //intermediate states were never reported, so everything changed
+    if (!enabled)
+        ozterm_notify_refresh(terminal);
+}
+
+uint8_t ozterm_get_fast_forward(Ozterm* terminal)
+{
+    return terminal->fast_forward;
+}
+
+static void ozterm_set_synchronized_output(Ozterm* terminal, uint8_t enabled)
+{
+    if (terminal->synchronized_output == enabled)
+        return;
+
+    terminal->synchronized_output = enabled;
+
+    if (enabled)
+    {
+        terminal->synchronized_output_start = ozterm_now_microseconds();
+        return;
+    }
+
+    //held callbacks are flushed as a single frame, snapshot damage was kept all along
+    if (terminal->refresh_function && !terminal->fast_forward)
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_REFRESH, refresh_callbacks, terminal->refresh_function(terminal));
+    }
+
+    if (terminal->move_cursor_function && !terminal->fast_forward)
+    {
+        int16_t row = terminal->screen_active->cursor_row;
+        int16_t column = terminal->screen_active->cursor_column;
+        OZTERM_CALLBACK(OZTERM_CALLBACK_MOVE_CURSOR, move_cursor_callbacks, terminal->move_cursor_function(terminal, row, column, row, column));
+    }
+}
+
+static void ozterm_check_synchronized_output_timeout(Ozterm* terminal)
+{
+    if (terminal->synchronized_output &&
+        ozterm_now_microseconds() - terminal->synchronized_output_start >= SYNCHRONIZED_OUTPUT_TIMEOUT_US)
+    {
+        ozterm_set_synchronized_output(terminal, 0);
+    }
+}
+
+uint8_t ozterm_get_synchronized_output(Ozterm* terminal)
+{
+    return terminal->synchronized_output;
+}
+
+void ozterm_enable_snapshots(Ozterm* terminal)
+{
+    if (terminal->snapshots)
+        return;
+
+    size_t cells_size = terminal->row_count * terminal->column_count * sizeof(OztermCell);
+
+    terminal->snapshots = malloc_impl(terminal, sizeof(OztermSnapshot) * SNAPSHOT_COUNT);
+    memset(terminal->snapshots, 0, sizeof(OztermSnapshot) * SNAPSHOT_COUNT);
+
+    for (int i = 0; i < SNAPSHOT_COUNT; ++i)
+    {
+        terminal->snapshots[i].buffer = malloc_impl(terminal, cells_size);
+        memset(terminal->snapshots[i].buffer, 0, cells_size);
+        terminal->snapshots[i].damage.rows = malloc_impl(terminal, terminal->row_count);
+        memset(terminal->snapshots[i].damage.rows, 0, terminal->row_count);
+    }
+
+    terminal->damage.rows = malloc_impl(terminal, terminal->row_count);
+    ozterm_damage_all(terminal, &terminal->damage);
+
+    terminal->snapshot_back = 0;
+    terminal->snapshot_front = 1;
+    atomic_init(&terminal->snapshot_latest, 2);
+}
+
+void ozterm_publish_snapshot(Ozterm* terminal)
+{
+    OztermSnapshot* snapshot = &terminal->snapshots[terminal->snapshot_back];
+
+    //a half drawn synchronized frame is not shown, its damage waits for the next publish
+    ozterm_check_synchronized_output_timeout(terminal);
+    if (terminal->synchronized_output)
+        return;
+
+    //no per-row damage is tracked while fast-forwarding
+    if (terminal->fast_forward)
+        ozterm_damage_all(terminal, &terminal->damage);
+
+    snapshot->row_count = terminal->row_count;
+    snapshot->column_count = terminal->column_count;
+    snapshot->cursor_row = terminal->screen_active->cursor_row;
+    snapshot->cursor_column = terminal->screen_active->cursor_column;
+    snapshot->scroll_offset = terminal->scroll_offset;
+    snapshot->scrollback_count = terminal->scrollback_count;
+    snapshot->fg_color_default = terminal->fg_color_default;
+    snapshot->bg_color_default = terminal->bg_color_default;
+    snapshot->sequence = ++terminal->snapshot_sequence;
+
+    for (int row = 0; row < terminal->row_count; ++row)
+    {
+        memcpy(snapshot->buffer + row * terminal->column_count,
+            ozterm_get_row_data(terminal, row),
+            sizeof(OztermCell) * terminal->column_count);
+    }
+
+    // If the renderer skipped the latest one, its damage must be carried over.
+    // The renderer may take it meanwhile and apply its scroll, so the merge only
+    // counts if the swap still replaces it; otherwise retry with our own damage.
+    OztermDamage* damage = &snapshot->damage;
+    int latest = atomic_load(&terminal->snapshot_latest);
+    for (;;)
+    {
+        const OztermDamage* source = &terminal->damage;
+        if (latest & SNAPSHOT_FRESH)
+            source = &terminal->snapshots[latest & ~SNAPSHOT_FRESH].damage;
+
+        memcpy(damage->rows, source->rows, terminal->row_count);
+        damage->scroll_top = source->scroll_top;
+        damage->scroll_bottom = source->scroll_bottom;
+        damage->scroll_lines = source->scroll_lines;
+        if (latest & SNAPSHOT_FRESH)
+            ozterm_damage_merge(terminal, damage, &terminal->damage);
+
+        //on failure latest is reloaded; only the renderer changes it, and only by taking it
+        if (atomic_compare_exchange_weak(&terminal->snapshot_latest, &latest, terminal->snapshot_back | SNAPSHOT_FRESH))
+            break;
+    }
+
+    memset(terminal->damage.rows, 0, terminal->row_count);
+    terminal->damage.scroll_lines = 0;
+
+    terminal->snapshot_back = latest & ~SNAPSHOT_FRESH;
+}
+
+const OztermSnapshot* ozterm_acquire_snapshot(Ozterm* terminal)
+{
+    if (!(atomic_load(&terminal->snapshot_latest) & SNAPSHOT_FRESH))
+        return NULL;
+
+    int latest = atomic_exchange(&terminal->snapshot_latest, terminal->snapshot_front);
+    terminal->snapshot_front = latest & ~SNAPSHOT_FRESH;
+
+    return &terminal->snapshots[terminal->snapshot_front];
+}
+
+uint32_t ozterm_get_snapshot_sequence(Ozterm* terminal)
+{
+    return terminal->snapshot_sequence;
+}
+
+uint32_t ozterm_snapshot_get_sequence(const OztermSnapshot* snapshot)
+{
+    return snapshot->sequence;
+}
+
+int16_t ozterm_snapshot_get_row_count(const OztermSnapshot* snapshot)
+{
+    return snapshot->row_count;
+}
+
+int16_t ozterm_snapshot_get_column_count(const OztermSnapshot* snapshot)
+{
+    return snapshot->column_count;
+}
+
+int16_t ozterm_snapshot_get_cursor_row(const OztermSnapshot* snapshot)
+{
+    return snapshot->cursor_row;
+}
+
+int16_t ozterm_snapshot_get_cursor_column(const OztermSnapshot* snapshot)
+{
+    return snapshot->cursor_column;
+}
+
+int16_t ozterm_snapshot_get_scroll(const OztermSnapshot* snapshot)
+{
+    return snapshot->scroll_offset;
+}
+
+int16_t ozterm_snapshot_get_scroll_count(const OztermSnapshot* snapshot)
+{
+    return snapshot->scrollback_count;
+}
+
+const OztermCell* ozterm_snapshot_get_row_data(const OztermSnapshot* snapshot, int16_t row)
+{
+    return snapshot->buffer + row * snapshot->column_count;
+}
+
+void ozterm_snapshot_get_default_color(const OztermSnapshot* snapshot, OztermColor* fg, OztermColor* bg)
+{
+    *fg = snapshot->fg_color_default;
+    *bg = snapshot->bg_color_default;
+}
+
+uint8_t ozterm_snapshot_is_row_dirty(const OztermSnapshot* snapshot, int16_t row)
+{
+    return snapshot->damage.rows[row];
+}
+
+int16_t ozterm_snapshot_get_scroll_delta(const OztermSnapshot* snapshot, int16_t* top, int16_t* bottom)
+{
+    *top = snapshot->damage.scroll_top;
+    *bottom = snapshot->damage.scroll_bottom;
+
+    return snapshot->damage.scroll_lines;
 }
 
 static void ozterm_switch_to_alt_screen(Ozterm* terminal)
 {
     terminal->alternative_active = 1;
     terminal->screen_active = terminal->screen_alternative;
+    OZTERM_PROBE2(alt__screen, terminal, 1);
 
     //clear alternate screen
     ozterm_reset_attributes(terminal);
     ozterm_clear(terminal);
 
-    if (terminal->refresh_function)
-    {
-        terminal->refresh_function(terminal);
-    }
+    ozterm_notify_refresh(terminal);
 }
 
 static void ozterm_restore_main_screen(Ozterm* terminal)
 {
     terminal->alternative_active = 0;
     terminal->screen_active = terminal->screen_main;
+    OZTERM_PROBE2(alt__screen, terminal, 0);
 
-    if (terminal->refresh_function)
-    {
-        terminal->refresh_function(terminal);
-    }
+    ozterm_notify_refresh(terminal);
 }
 
 static uint8_t ozterm_is_cell_writable(Ozterm * terminal, OztermCell * cell)
@@ -346,6 +1119,7 @@ static void ozterm_set_character(Ozterm * terminal, int16_t row, int16_t column,
 
         if (ozterm_is_cell_writable(terminal, cell))
         {
+            OZTERM_STAT(cells_written++);
             cell->character = character;
 
             if (terminal->screen_active->attr_inverse)
@@ -359,8 +1133,8 @@ static void ozterm_set_character(Ozterm * terminal, int16_t row, int16_t column,
                 cell->bg_color = terminal->screen_active->bg_color;
             }
 
-            if (callback && terminal->set_character_function)
-                terminal->set_character_function(terminal, row, column, cell);
+            if (callback)
+                ozterm_notify_character(terminal, row, column, cell);
         }
     }
 }
@@ -378,6 +1152,8 @@ static void ozterm_scroll_up(Ozterm* terminal, int lines)
             sizeof(OztermCell) * terminal->column_count
         );
         terminal->scrollback_head = (terminal->scrollback_head + 1) % SCROLLBACK_LINES;
+        OZTERM_STAT(scrollback_pushes++);
+        OZTERM_PROBE2(scrollback__push, terminal, terminal->scrollback_count);
         if (terminal->scrollback_count < SCROLLBACK_LINES)
             terminal->scrollback_count++;
     }
@@ -398,6 +1174,8 @@ static void ozterm_scroll_up_region(Ozterm* terminal, int lines)
     if (lines > bottom - top + 1)
         lines = bottom - top + 1;
 
+    OZTERM_PROBE4(scroll__up, terminal, top, bottom, lines);
+
     // Scroll UP: move lines up
     for (int y = top; y <= bottom - lines; ++y)
     {
@@ -421,8 +1199,7 @@ static void ozterm_scroll_up_region(Ozterm* terminal, int lines)
         }
     }
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    ozterm_notify_scroll(terminal, top, bottom, lines);
 }
 
 static void ozterm_scroll_down_region(Ozterm* terminal, int lines)
@@ -440,6 +1217,8 @@ static void ozterm_scroll_down_region(Ozterm* terminal, int lines)
         lines = bottom - top + 1;
     }
 
+    OZTERM_PROBE4(scroll__down, terminal, top, bottom, lines);
+
     // Scroll DOWN: move lines from bottom up to top
     for (int row = bottom; row >= top + lines; --row)
     {
@@ -464,8 +1243,7 @@ static void ozterm_scroll_down_region(Ozterm* terminal, int lines)
         }
     }
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    ozterm_notify_scroll(terminal, top, bottom, -lines);
 }
 
 static void ozterm_insert_lines(Ozterm* terminal, int from_row, int count)
@@ -505,8 +1283,7 @@ static void ozterm_insert_lines(Ozterm* terminal, int from_row, int count)
         }
     }
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    ozterm_notify_scroll(terminal, top, bottom, -count);
 }
 
 static void ozterm_delete_lines(Ozterm* terminal, int from_row, int count)
@@ -546,8 +1323,7 @@ static void ozterm_delete_lines(Ozterm* terminal, int from_row, int count)
         }
     }
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    ozterm_notify_scroll(terminal, top, bottom, count);
 }
 
 
@@ -563,8 +1339,7 @@ static void ozterm_clear(Ozterm* terminal)
 
     ozterm_move_cursor(terminal, 0, 0);
 
-    if (terminal->refresh_function)
-        terminal->refresh_function(terminal);
+    ozterm_notify_refresh(terminal);
 }
 
 static void ozterm_line_insert_characters(Ozterm* terminal, uint8_t c, int16_t count)
@@ -590,8 +1365,7 @@ static void ozterm_line_insert_characters(Ozterm* terminal, uint8_t c, int16_t c
             {
                 cell[i] = cell[src];
 
-                if (terminal->set_character_function)
-                    terminal->set_character_function(terminal, terminal->screen_active->cursor_row, i, &cell[i]);
+                ozterm_notify_character(terminal, terminal->screen_active->cursor_row, i, &cell[i]);
             }
             else
             {
@@ -632,8 +1406,7 @@ static void ozterm_line_delete_characters(Ozterm* terminal, int16_t count)
             {
                 cell[i] = cell[src];
 
-                if (terminal->set_character_function)
-                    terminal->set_character_function(terminal, terminal->screen_active->cursor_row, i, &cell[i]);
+                ozterm_notify_character(terminal, terminal->screen_active->cursor_row, i, &cell[i]);
             }
             else
             {
@@ -712,29 +1485,123 @@ void ozterm_put_character_and_cursor(Ozterm* terminal, uint8_t c)
 }
 
 
+// Parses "rgb:R/G/B" (1-4 hex digits per component) or "#RRGGBB"
+static int ozterm_parse_color_spec(const char* spec, uint8_t* red, uint8_t* green, uint8_t* blue)
+{
+    uint8_t* components[3] = {red, green, blue};
+
+    if (strncmp(spec, "rgb:", 4) == 0)
+    {
+        const char* p = spec + 4;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            char* end = NULL;
+            unsigned long value = strtoul(p, &end, 16);
+            int digits = (int)(end - p);
+
+            if (digits < 1 || digits > 4)
+                return 0;
+
+            // like XParseColor, repeat the digits to fill 16 bits (8 -> 8888, abc -> abca),
+            // then keep the most significant byte as xterm does: 8 -> 88, 80 -> 80, 8000 -> 80
+            unsigned long repeated = value;
+            int bits = digits * 4;
+            for (; bits < 16; bits += digits * 4)
+                repeated = (repeated << (digits * 4)) | value;
+            *components[i] = (uint8_t)(repeated >> (bits - 8));
+
+            p = end;
+            if (i < 2)
+            {
+                if (*p != '/')
+                    return 0;
+                ++p;
+            }
+        }
+
+        return 1;
+    }
+    else if (spec[0] == '#' && strlen(spec) == 7)
+    {
+        unsigned long value = strtoul(spec + 1, NULL, 16);
+        *red = (value >> 16) & 0xFF;
+        *green = (value >> 8) & 0xFF;
+        *blue = value & 0xFF;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static void ozterm_handle_osc(Ozterm* terminal, const char* osc)
+{
+    if (!terminal->palette_function)
+        return;
+
+    char* p = NULL;
+    long code = strtol(osc, &p, 10);
+
+    if (p == osc || *p != ';')
+        return;
+
+    ++p;
+
+    uint8_t r, g, b;
+
+    if (code == 4)
+    {
+        // OSC 4 ; index ; spec [; index ; spec ...]
+        while (*p)
+        {
+            long index = strtol(p, &p, 10);
+            if (*p != ';')
+                break;
+            ++p;
+
+            char spec[32];
+            int len = 0;
+            while (*p && *p != ';' && len < (int)sizeof(spec) - 1)
+                spec[len++] = *p++;
+            spec[len] = '\0';
+
+            // "?" queries are not answered
+            if (index >= 0 && index < 256 && ozterm_parse_color_spec(spec, &r, &g, &b))
+            {
+                OZTERM_CALLBACK(OZTERM_CALLBACK_PALETTE, palette_callbacks, terminal->palette_function(terminal, (int16_t)index, r, g, b));
+            }
+
+            if (*p == ';')
+                ++p;
+        }
+    }
+    else if ((code == 10 || code == 11) && ozterm_parse_color_spec(p, &r, &g, &b))
+    {
+        OZTERM_CALLBACK(OZTERM_CALLBACK_PALETTE, palette_callbacks, terminal->palette_function(terminal, code == 10 ? OZTERM_PALETTE_FG : OZTERM_PALETTE_BG, r, g, b));
+    }
+}
+
 static void ozterm_put_character(Ozterm* terminal, uint8_t c)
 {
-    static enum ParseState { STATE_NORMAL, STATE_ESC, STATE_CSI, STATE_OSC, STATE_G0, STATE_G1, STATE_HASH } parse_state = STATE_NORMAL;
-    static char param_buf[32];
-    static int param_len = 0;
-    static char seq_buf[64];
-    static int seq_len = 0;
-    static char osc_buf[64];
-    static int osc_index = 0;
-    static char final_byte = 0;
-    static uint8_t is_private = 0;
+    OztermParser* parser = &terminal->parser;
 
     //print_debug_character(c);
 
-    switch (parse_state)
+    switch (parser->state)
     {
         case STATE_NORMAL:
             if (c == '\033')
             {
-                parse_state = STATE_ESC;
+                parser->state = STATE_ESC;
             } 
             else
             {
+                if (c < 0x20 || c == 0x7F)
+                    OZTERM_STAT(control_bytes++);
+                else
+                    OZTERM_STAT(printable_bytes++);
+
                 if ((c >= 0x20 && c <= 0x7E) || c == '\n' || c == '\r' || c == '\b' || c == '\t')
                 {  
                     ozterm_put_character_and_cursor(terminal, c);
@@ -743,107 +1610,116 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
             break;
 
         case STATE_ESC:
+            if (c != '[' && c != ']')
+                OZTERM_STAT(esc[c & 0x7F]++);
+
             if (c == '[')
             {
-                parse_state = STATE_CSI;
-                param_len = 0;
-                seq_len = 0;
-                is_private = 0;
-                param_buf[0] = '\0';
-                seq_buf[0] = '\0';
+                parser->state = STATE_CSI;
+                parser->param_len = 0;
+                parser->seq_len = 0;
+                parser->is_private = 0;
+                parser->intermediate = 0;
+                parser->param_buf[0] = '\0';
+                parser->seq_buf[0] = '\0';
             }
             else if (c == ']')
             {
-                parse_state = STATE_OSC;
-                osc_index = 0;
-                osc_buf[0] = '\0';
+                parser->state = STATE_OSC;
+                parser->osc_index = 0;
+                parser->osc_buf[0] = '\0';
             }
             else if (c == '(')
             {
-                parse_state = STATE_G0;
+                parser->state = STATE_G0;
             }
             else if (c == ')')
             {
-                parse_state = STATE_G1;
+                parser->state = STATE_G1;
             }
             else if (c == '#')
             {
-                parse_state = STATE_HASH;
+                parser->state = STATE_HASH;
             }
             else if (c == '7')
             {
                 terminal->saved_cursor_row = terminal->screen_active->cursor_row;
                 terminal->saved_cursor_column = terminal->screen_active->cursor_column;
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == '8')
             {
                 ozterm_move_cursor(terminal, terminal->saved_cursor_row, terminal->saved_cursor_column);
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == 'c')
             {
                 // ESC c — Full reset (RIS).
                 ozterm_clear(terminal);
                 ozterm_move_cursor(terminal, 0, 0);
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == 'D')
             {
                 // ESC D — Index: Move cursor down
                 ozterm_move_cursor_diff(terminal, 1, 0);
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == 'E')
             {
                 // ESC E — Next line (CR + LF)
                 ozterm_move_cursor(terminal, terminal->screen_active->cursor_row + 1, 0);
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == 'M')
             {
                 // ESC M — Reverse index (scroll down)
                 ozterm_scroll_down_region(terminal, 1);
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else if (c == 'Z')
             {
                 // ESC Z — Identify terminal (DECID), reply with ESC[?6c
                 const char* reply = "\033[?6c";
                 write_to_master(terminal, reply, strlen(reply));
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             } 
             else if (c == '\\')
             {
                 // ESC \ — ST (used to end OSC), absorb silently
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             else
             {
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
             }
             break;
         case STATE_OSC:
             if (c == '\a')
             {  // BEL = end of OSC
-                parse_state = STATE_NORMAL;
-                osc_buf[osc_index] = '\0';
+                OZTERM_STAT(osc++);
+                parser->state = STATE_NORMAL;
+                parser->osc_buf[parser->osc_index] = '\0';
+                ozterm_handle_osc(terminal, parser->osc_buf);
             }
             else if (c == '\033')
             {
                 // ESC — maybe ST terminator?
-                parse_state = STATE_ESC;  // check for ESC \ in next char
+                OZTERM_STAT(osc++);
+                parser->state = STATE_ESC;  // check for ESC \ in next char
+                parser->osc_buf[parser->osc_index] = '\0';
+                ozterm_handle_osc(terminal, parser->osc_buf);
             }
-            else if (osc_index < sizeof(osc_buf) - 1)
+            else if (parser->osc_index < sizeof(parser->osc_buf) - 1)
             {
-                osc_buf[osc_index++] = c;
-                osc_buf[osc_index] = '\0';
+                parser->osc_buf[parser->osc_index++] = c;
+                parser->osc_buf[parser->osc_index] = '\0';
             }
             break;
             case STATE_G0:
             case STATE_G1:
                 // Valid values: 'B' (ASCII), '0' (line drawing), etc.
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
                 break;
             case STATE_HASH:
                 if (c == '8') {
@@ -855,51 +1731,58 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                             ozterm_set_character(terminal, y, x, 'E', 0);
                         }
                     }
-                    if (terminal->refresh_function)
-                        terminal->refresh_function(terminal);
+                    ozterm_notify_refresh(terminal);
 
                     ozterm_move_cursor(terminal, 0, 0);
                 }
-                parse_state = STATE_NORMAL;
+                parser->state = STATE_NORMAL;
 
                 break;
 
         case STATE_CSI:
-            if (seq_len < (int)sizeof(seq_buf) - 1)
+            if (parser->seq_len < (int)sizeof(parser->seq_buf) - 1)
             {
-                seq_buf[seq_len++] = c;
-                seq_buf[seq_len] = '\0';
+                parser->seq_buf[parser->seq_len++] = c;
+                parser->seq_buf[parser->seq_len] = '\0';
             }
 
             // Recognize private mode prefix
             if (c == '?' || c == '>')
             {
-                is_private = 1;
-                break;  // Do not add to param_buf
+                parser->is_private = 1;
+                break;  // Do not add to parser->param_buf
             }
 
             // Collect parameters
             if ((c >= '0' && c <= '9') || c == ';')
             {
-                if (param_len < (int)sizeof(param_buf) - 1)
+                if (parser->param_len < (int)sizeof(parser->param_buf) - 1)
                 {
-                    param_buf[param_len++] = c;
-                    param_buf[param_len] = '\0';
+                    parser->param_buf[parser->param_len++] = c;
+                    parser->param_buf[parser->param_len] = '\0';
                 }
                 break;
             }
 
+            // Intermediate bytes such as '$' in DECRQM
+            if (c >= ' ' && c <= '/')
+            {
+                parser->intermediate = c;
+                break;
+            }
+
             // Final byte detected
             if (c < '@' || c > '~')
             {
-                parse_state = STATE_NORMAL;
-                param_len = 0;
-                seq_len = 0;
+                parser->state = STATE_NORMAL;
+                parser->param_len = 0;
+                parser->seq_len = 0;
                 break;
             }
 
-            final_byte = c;
-            const char* effective_param = param_buf;
+            parser->final_byte = c;
+            OZTERM_STAT(csi[c & 0x7F]++);
+            const char* effective_param = parser->param_buf;
 
             int p1 = 1, p2 = 1;
             
@@ -915,7 +1798,11 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
 
             int handled = 1;
 
-            switch (final_byte)
+            //only DECRQM ($p) takes an intermediate; anything else with one (DECCARA, SL, SR...)
+            //is a different sequence than its plain final byte, so it falls to default
+            int plain = parser->intermediate == 0 || parser->final_byte == 'p';
+
+            switch (plain ? parser->final_byte : 0)
             {
                 case 'A': ozterm_move_cursor_diff(terminal, -p1, 0); break;
                 case 'B': ozterm_move_cursor_diff(terminal, p1, 0); break;
@@ -1021,7 +1908,7 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                 }
                 case 'm': {
                     handled = 1;  // will reset to 0 only if nothing matches
-                    char* p = param_buf;
+                    char* p = parser->param_buf;
                     if (p)
                     {
                         if (*p == '\0')
@@ -1040,21 +1927,25 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                                 {
                                     terminal->screen_active->fg_color.index = code - 30;
                                     terminal->screen_active->fg_color.use_rgb = 0;
+                                    terminal->screen_active->fg_color.use_default = 0;
                                 }
                                 else if (code >= 40 && code <= 47)
                                 {
                                     terminal->screen_active->bg_color.index = code - 40;
                                     terminal->screen_active->bg_color.use_rgb = 0;
+                                    terminal->screen_active->bg_color.use_default = 0;
                                 }
                                 else if (code >= 90 && code <= 97)
                                 {
                                     terminal->screen_active->fg_color.index = code - 90 + 8;
                                     terminal->screen_active->fg_color.use_rgb = 0;
+                                    terminal->screen_active->fg_color.use_default = 0;
                                 }
                                 else if (code >= 100 && code <= 107)
                                 {
                                     terminal->screen_active->bg_color.index = code - 100 + 8;
                                     terminal->screen_active->bg_color.use_rgb = 0;
+                                    terminal->screen_active->bg_color.use_default = 0;
                                 }
                                 else if (code == 7)
                                     terminal->screen_active->attr_inverse = 1;
@@ -1079,11 +1970,13 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                                         {
                                             terminal->screen_active->fg_color.index = (uint8_t)idx;
                                             terminal->screen_active->fg_color.use_rgb = 0;
+                                            terminal->screen_active->fg_color.use_default = 0;
                                         }
                                         else
                                         {
                                             terminal->screen_active->bg_color.index = (uint8_t)idx;
                                             terminal->screen_active->bg_color.use_rgb = 0;
+                                            terminal->screen_active->bg_color.use_default = 0;
                                         }
                                     }
                                     else if (mode == 2 && *p == ';') {
@@ -1100,6 +1993,7 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                                             terminal->screen_active->fg_color.green = (uint8_t)g;
                                             terminal->screen_active->fg_color.blue = (uint8_t)b;
                                             terminal->screen_active->fg_color.use_rgb = 1;
+                                            terminal->screen_active->fg_color.use_default = 0;
                                         }
                                         else
                                         {
@@ -1107,6 +2001,7 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                                             terminal->screen_active->bg_color.green = (uint8_t)g;
                                             terminal->screen_active->bg_color.blue = (uint8_t)b;
                                             terminal->screen_active->bg_color.use_rgb = 1;
+                                            terminal->screen_active->bg_color.use_default = 0;
                                         }
                                     }
                                     // else: unsupported sub-mode, ignore
@@ -1121,35 +2016,39 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                     break;
                 }
                 case 'h':
-                    if (is_private && strcmp(effective_param, "1049") == 0)
+                    if (parser->is_private && strcmp(effective_param, "1049") == 0)
                     {
                         ozterm_switch_to_alt_screen(terminal);
                     }
-                    else if (is_private && strcmp(effective_param, "2004") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "2004") == 0)
+                    {
+                        terminal->bracketed_paste = 1;
+                    }
+                    else if (parser->is_private && strcmp(effective_param, "2026") == 0)
                     {
-                        // Enable bracketed paste mode
+                        ozterm_set_synchronized_output(terminal, 1);
                     }
-                    else if (is_private && strcmp(effective_param, "25") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "25") == 0)
                     {
                         //terminal->cursor_visible = true;
                     }
-                    else if (is_private && strcmp(effective_param, "12") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "12") == 0)
                     {
                         // enable cursor blink
                     }
-                    else if (is_private && strcmp(effective_param, "7") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "7") == 0)
                     {
                         //terminal->autowrap_enabled = true;
                     }
-                    else if (is_private && strcmp(effective_param, "8") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "8") == 0)
                     {
                         //set auto-repeat: no need to implement
                     }
-                    else if (is_private && strcmp(effective_param, "1") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "1") == 0)
                     {
                         terminal->DECCKM = 1;
                     }
-                    else if (is_private && strcmp(effective_param, "3") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "3") == 0)
                     {
                         //DECCOLM: Set number of columns to 132 : ignore
                     }
@@ -1159,35 +2058,39 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                     }
                     break;
                 case 'l':
-                    if (is_private && strcmp(effective_param, "1049") == 0)
+                    if (parser->is_private && strcmp(effective_param, "1049") == 0)
                     {
                         ozterm_restore_main_screen(terminal);
                     }
-                    else if (is_private && strcmp(effective_param, "2004") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "2004") == 0)
                     {
-                        // Disable bracketed paste mode
+                        terminal->bracketed_paste = 0;
                     }
-                    else if (is_private && strcmp(effective_param, "25") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "2026") == 0)
+                    {
+                        ozterm_set_synchronized_output(terminal, 0);
+                    }
+                    else if (parser->is_private && strcmp(effective_param, "25") == 0)
                     {
                         // terminal->cursor_visible = false;
                     }
-                    else if (is_private && strcmp(effective_param, "12") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "12") == 0)
                     {
                         // disable cursor blink
                     }
-                    else if (is_private && strcmp(effective_param, "7") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "7") == 0)
                     {
                         //terminal->autowrap_enabled = false;
                     }
-                    else if (is_private && strcmp(effective_param, "8") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "8") == 0)
                     {
                         //reset auto-repeat: no need to implement
                     }
-                    else if (is_private && strcmp(effective_param, "1") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "1") == 0)
                     {
                         terminal->DECCKM = 0;
                     }
-                    else if (is_private && strcmp(effective_param, "3") == 0)
+                    else if (parser->is_private && strcmp(effective_param, "3") == 0)
                     {
                         //DECCOLM: Set number of columns to 132 : ignore
                     }
@@ -1203,11 +2106,11 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                         const char* reply = "\033[1t"; // Window is visible
                         write_to_master(terminal, reply, strlen(reply));
                     }
-                    else if (strncmp(param_buf, "22;", 3) == 0)
+                    else if (strncmp(parser->param_buf, "22;", 3) == 0)
                     {
                         // Ignore all title stack ops
                     }
-                    else if (strncmp(param_buf, "23;", 3) == 0)
+                    else if (strncmp(parser->param_buf, "23;", 3) == 0)
                     {
                         // Ignore icon name stack ops
                     }
@@ -1217,15 +2120,33 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                     }
                     break;
                 }
+                case 'p':
+                    //DECRQM, lets applications detect synchronized output support
+                    if (parser->is_private && parser->intermediate == '$')
+                    {
+                        int mode = atoi(effective_param);
+                        int value = 0; //not recognized
+                        if (mode == 2026)
+                            value = terminal->synchronized_output ? 1 : 2;
+
+                        char reply[32];
+                        snprintf(reply, sizeof(reply), "\033[?%d;%d$y", mode, value);
+                        write_to_master(terminal, reply, strlen(reply));
+                    }
+                    else
+                    {
+                        handled = 0;
+                    }
+                    break;
                 case 'c':
-                    if (is_private)
+                    if (parser->is_private)
                     {
                         const char* reply = "\033[>0;0;0c";
                         write_to_master(terminal, reply, strlen(reply));
                     }
                     else
                     {
-                        if (strcmp(param_buf, "0") == 0) //CSI [0c (DA request)
+                        if (strcmp(parser->param_buf, "0") == 0) //CSI [0c (DA request)
                         {
                             const char* reply = "\033[?1;0c";
                             write_to_master(terminal, reply, strlen(reply));
@@ -1286,19 +2207,19 @@ static void ozterm_put_character(Ozterm* terminal, uint8_t c)
                     break;
             }
 
+            OZTERM_PROBE4(csi__dispatch, terminal, parser->final_byte, p1, handled);
+
             if (!handled)
             {
-                printf("Unhandled CSI sequence: CSI [%s%s%c\n",
-                    is_private ? "?" : "",
-                    param_buf[0] ? param_buf : "",
-                    final_byte);
+                OZTERM_STAT(unhandled++);
+                ozterm_count_unhandled(terminal);
             }
 
-            //fprintf(stderr, "CSI parsed: [%s%c\n", param_buf, final_byte);
+            //fprintf(stderr, "CSI parsed: [%s%c\n", parser->param_buf, parser->final_byte);
 
-            parse_state = STATE_NORMAL;
-            param_len = 0;
-            seq_len = 0;
+            parser->state = STATE_NORMAL;
+            parser->param_len = 0;
+            parser->seq_len = 0;
             
             break;
     }
@@ -1338,9 +2259,9 @@ static void ozterm_move_cursor(Ozterm* terminal, int16_t row, int16_t column)
         column = 0;
     }
 
-    if (terminal->move_cursor_function)
+    if (terminal->move_cursor_function && !terminal->fast_forward && !terminal->synchronized_output)
     {
-        terminal->move_cursor_function(terminal, terminal->screen_active->cursor_row, terminal->screen_active->cursor_column, row, column);
+        OZTERM_CALLBACK(OZTERM_CALLBACK_MOVE_CURSOR, move_cursor_callbacks, terminal->move_cursor_function(terminal, terminal->screen_active->cursor_row, terminal->screen_active->cursor_column, row, column));
     }
 
     terminal->screen_active->cursor_row = row;
@@ -1468,13 +2389,152 @@ void ozterm_send_key(Ozterm* terminal, OztermKeyModifier modifier, uint8_t key)
         break;
     }
 
-    if (terminal->write_to_master_function && size > 0)
+    write_input_to_master(terminal, seq, size);
+}
+
+static void ozterm_send_chunked(Ozterm* terminal, const uint8_t* text, int32_t size, uint8_t paste)
+{
+    static const char paste_start[] = "\033[200~";
+    static const char paste_end[] = "\033[201~";
+    const int32_t marker_size = sizeof(paste_end) - 1;
+
+    uint8_t chunk[SEND_CHUNK_SIZE];
+    int32_t length = 0;
+    uint8_t bracketed = paste && terminal->bracketed_paste;
+
+    if (bracketed)
+    {
+        memcpy(chunk, paste_start, marker_size);
+        length = marker_size;
+    }
+
+    for (int32_t i = 0; i < size; ++i)
+    {
+        uint8_t c = text[i];
+
+        if (paste)
+        {
+            //an end marker inside the text would let the rest run as typed input
+            if (bracketed && c == '\033' && size - i >= marker_size && memcmp(text + i, paste_end, marker_size) == 0)
+            {
+                i += marker_size - 1;
+                continue;
+            }
+
+            //CR LF and LF both become a single CR, like pressing Enter
+            if (c == '\n')
+            {
+                if (i > 0 && text[i - 1] == '\r')
+                    continue;
+                c = '\r';
+            }
+        }
+
+        if (length == SEND_CHUNK_SIZE)
+        {
+            write_input_to_master(terminal, chunk, length);
+            length = 0;
+        }
+
+        chunk[length++] = c;
+    }
+
+    if (bracketed)
     {
-        terminal->write_to_master_function(terminal, seq, size);
+        if (length + marker_size > SEND_CHUNK_SIZE)
+        {
+            write_input_to_master(terminal, chunk, length);
+            length = 0;
+        }
+
+        memcpy(chunk + length, paste_end, marker_size);
+        length += marker_size;
     }
+
+    write_input_to_master(terminal, chunk, length);
+}
+
+void ozterm_send_text(Ozterm* terminal, const uint8_t* text, int32_t size)
+{
+    ozterm_send_chunked(terminal, text, size, 0);
+}
+
+void ozterm_send_paste(Ozterm* terminal, const uint8_t* text, int32_t size)
+{
+    ozterm_send_chunked(terminal, text, size, 1);
+}
+
+static uint64_t ozterm_now_microseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t ozterm_now_nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
 void ozterm_have_read_from_master(Ozterm* terminal, const uint8_t* data, int32_t size)
 {
-    ozterm_put_text(terminal, data, size);
+    ozterm_have_read_from_master_budget(terminal, data, size, 0, 0);
+}
+
+int32_t ozterm_have_read_from_master_budget(Ozterm* terminal, const uint8_t* data, int32_t size, int32_t max_bytes, uint32_t max_microseconds)
+{
+    if (max_bytes > 0 && max_bytes < size)
+        size = max_bytes;
+
+    OZTERM_PROBE2(chunk__begin, terminal, size);
+
+    uint64_t chunk_start = terminal->timing ? ozterm_now_nanoseconds() : 0;
+
+    int32_t i = 0;
+
+    if (max_microseconds == 0)
+    {
+        for (; i < size; ++i)
+        {
+            ozterm_put_character(terminal, data[i]);
+        }
+    }
+    else
+    {
+        uint64_t deadline = ozterm_now_microseconds() + max_microseconds;
+
+        while (i < size)
+        {
+            int32_t step_end = i + BUDGET_CHECK_INTERVAL;
+            if (step_end > size)
+                step_end = size;
+
+            for (; i < step_end; ++i)
+            {
+                ozterm_put_character(terminal, data[i]);
+            }
+
+            if (ozterm_now_microseconds() >= deadline)
+                break;
+        }
+    }
+
+    ozterm_check_synchronized_output_timeout(terminal);
+    ozterm_check_unhandled_report(terminal);
+
+    if (terminal->timing)
+        ozterm_histogram_add(&terminal->timing->chunk, ozterm_now_nanoseconds() - chunk_start);
+
+    OZTERM_PROBE2(chunk__end, terminal, i);
+
+    OZTERM_STAT(bytes += i);
+
+    if (terminal->record_function && i > 0)
+    {
+        terminal->record_function(terminal, OZTERM_RECORD_OUTPUT, data, i);
+    }
+
+    return i;
 }
\ No newline at end of file
@@ -28,9 +28,11 @@
 #ifndef OZTERM_H
 #define OZTERM_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct Ozterm Ozterm;
+typedef struct OztermSnapshot OztermSnapshot;
 
 typedef struct OztermColor
 {
@@ -39,8 +41,14 @@ typedef struct OztermColor
     uint8_t green;
     uint8_t blue;
     uint8_t use_rgb;
+    //OZTERM_COLOR_DEFAULT_FG/BG when this is the default color (SGR 0, 39, 49), which
+    //OSC 10/11 change apart from the palette; index still holds a palette fallback
+    uint8_t use_default;
 } OztermColor;
 
+#define OZTERM_COLOR_DEFAULT_FG 1
+#define OZTERM_COLOR_DEFAULT_BG 2
+
 typedef struct OztermCell
 {
     uint8_t character;
@@ -52,6 +60,112 @@ typedef void (*OztermRefresh)(Ozterm* terminal);
 typedef void (*OztermSetCharacter)(Ozterm* terminal, int16_t row, int16_t column, OztermCell* cell);
 typedef void (*OztermMoveCursor)(Ozterm* terminal, int16_t old_row, int16_t old_column, int16_t row, int16_t column);
 typedef void (*OztermWriteToMaster)(Ozterm* terminal, const uint8_t* data, int32_t size);
+//rows top..bottom (inclusive) moved by lines: positive is up (new rows exposed at bottom), negative is down
+typedef void (*OztermScrollRegion)(Ozterm* terminal, int16_t top, int16_t bottom, int16_t lines);
+//index is 0..255 for OSC 4, or OZTERM_PALETTE_FG/OZTERM_PALETTE_BG for OSC 10/11,
+//which change only the colors marked use_default, not palette entries
+typedef void (*OztermSetPalette)(Ozterm* terminal, int16_t index, uint8_t red, uint8_t green, uint8_t blue);
+
+#define OZTERM_PALETTE_FG 256
+#define OZTERM_PALETTE_BG 257
+
+//direction is OZTERM_RECORD_OUTPUT for bytes read from master (after they are parsed),
+//OZTERM_RECORD_INPUT for keys, text and pastes sent to master (replies are not included)
+typedef void (*OztermRecord)(Ozterm* terminal, uint8_t direction, const uint8_t* data, int32_t size);
+
+#define OZTERM_RECORD_OUTPUT 0
+#define OZTERM_RECORD_INPUT 1
+
+//Host callbacks, as reported by the callback__begin/callback__end tracepoints
+typedef enum OztermCallbackKind
+{
+    OZTERM_CALLBACK_REFRESH,
+    OZTERM_CALLBACK_SET_CHARACTER,
+    OZTERM_CALLBACK_MOVE_CURSOR,
+    OZTERM_CALLBACK_SCROLL,
+    OZTERM_CALLBACK_WRITE_TO_MASTER,
+    OZTERM_CALLBACK_PALETTE,
+    OZTERM_CALLBACK_COUNT
+} OztermCallbackKind;
+
+//Log bucketed latencies in nanoseconds: four buckets per power of two, so a bucket is
+//at most 25% wide, up to about half an hour
+#define OZTERM_HISTOGRAM_BUCKETS 160
+
+typedef struct OztermHistogram
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[OZTERM_HISTOGRAM_BUCKETS];
+} OztermHistogram;
+
+//time spent per ozterm_have_read_from_master call (callbacks included) and per host callback
+typedef struct OztermTiming
+{
+    OztermHistogram chunk;
+    OztermHistogram callbacks[OZTERM_CALLBACK_COUNT];
+} OztermTiming;
+
+//A kind of escape sequence the parser ignored, keyed by private marker, intermediate
+//byte (0 when none), final byte and first parameter (-1 when it had none), with how
+//often it was seen
+typedef struct OztermUnhandled
+{
+    uint8_t is_private;
+    char intermediate;
+    char final_byte;
+    int32_t first_param;
+    uint32_t count;
+} OztermUnhandled;
+
+//others counts the occurrences that did not fit in the table
+typedef void (*OztermReportUnhandled)(Ozterm* terminal, const OztermUnhandled* sequences, int32_t count, uint32_t others);
+
+//Counters of what the parser did, for finding out why a session is slow.
+//They are only kept when ozterm.c is compiled with -DOZTERM_ENABLE_STATS.
+typedef struct OztermStats
+{
+    uint64_t bytes;                     //read from master and parsed
+    uint64_t printable_bytes;           //outside of escape sequences
+    uint64_t control_bytes;             //C0 controls and DEL outside of escape sequences
+    uint64_t esc[128];                  //ESC sequences by final byte, CSI and OSC not included
+    uint64_t csi[128];                  //CSI sequences by final byte
+    uint64_t osc;
+    uint64_t unhandled;                 //CSI sequences that were ignored
+    uint64_t scrolls;                   //region scrolls and line inserts/deletes
+    uint64_t scrolled_lines;
+    uint64_t scrollback_pushes;
+    uint64_t cells_written;
+    uint64_t refresh_callbacks;
+    uint64_t set_character_callbacks;
+    uint64_t move_cursor_callbacks;
+    uint64_t scroll_callbacks;
+    uint64_t write_to_master_callbacks;
+    uint64_t palette_callbacks;
+} OztermStats;
+
+//Where a terminal gets its memory. context is passed back on every call.
+//Everything is allocated on create or when a feature is enabled, parsing allocates nothing.
+typedef void* (*OztermMalloc)(void* context, size_t size);
+typedef void (*OztermFree)(void* context, void* address);
+
+typedef struct OztermAllocator
+{
+    OztermMalloc malloc_func;
+    OztermFree free_func;
+    void* context;
+} OztermAllocator;
+
+//Kept by the tracking allocator, one per terminal: it is not thread safe,
+//so read it where the terminal is used
+typedef struct OztermAllocationStats
+{
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t allocations;
+    uint64_t frees;
+} OztermAllocationStats;
 
 
 typedef enum OztermKeyModifier
@@ -95,10 +209,32 @@ typedef enum OztermKeyModifier
 
 
 Ozterm* ozterm_create(uint16_t row_count, uint16_t column_count);
+//allocator is copied, NULL means malloc and free
+Ozterm* ozterm_create_with_allocator(uint16_t row_count, uint16_t column_count, const OztermAllocator* allocator);
+//fills allocator with malloc and free wrappers that count into stats, which must outlive the terminal
+void ozterm_tracking_allocator_init(OztermAllocator* allocator, OztermAllocationStats* stats);
 void ozterm_destroy(Ozterm* terminal);
 void ozterm_clear_full(Ozterm* terminal);
 void ozterm_set_write_to_master_callback(Ozterm* terminal, OztermWriteToMaster function);
 void ozterm_set_render_callbacks(Ozterm* terminal, OztermRefresh refresh_func, OztermSetCharacter character_func, OztermMoveCursor cursor_func);
+//optional: when set, region scrolls are reported here instead of a full refresh
+void ozterm_set_scroll_callback(Ozterm* terminal, OztermScrollRegion scroll_func);
+void ozterm_set_palette_callback(Ozterm* terminal, OztermSetPalette palette_func);
+//Timing costs two clock reads per callback, so it is off until enabled.
+//Enabling clears the histograms, get copies them (returns 0 while disabled).
+//Call both on the thread that parses.
+void ozterm_set_timing(Ozterm* terminal, uint8_t enabled);
+uint8_t ozterm_get_timing(Ozterm* terminal, OztermTiming* timing);
+//upper bound of the bucket holding the given percentile (0..100), never above the max
+uint64_t ozterm_histogram_percentile(const OztermHistogram* histogram, double percentile);
+
+//optional: unhandled sequences are counted silently and reported here at most once per
+//interval_milliseconds, from the parsing thread, so print them from this callback if needed
+void ozterm_set_unhandled_callback(Ozterm* terminal, OztermReportUnhandled report_func, uint32_t interval_milliseconds);
+//reports what was counted since the last report now, if anything
+void ozterm_report_unhandled(Ozterm* terminal);
+//optional: sees everything the session received and sent, for recording it
+void ozterm_set_record_callback(Ozterm* terminal, OztermRecord record_func);
 void ozterm_set_custom_data(Ozterm* terminal, void* custom_data);
 void* ozterm_get_custom_data(Ozterm* terminal);
 int16_t ozterm_get_row_count(Ozterm* terminal);
@@ -116,10 +252,66 @@ void ozterm_scroll(Ozterm* terminal, int16_t scroll_offset);
 int16_t ozterm_get_scroll(Ozterm* terminal);
 int16_t ozterm_get_scroll_count(Ozterm* terminal);
 
+//copies the counters, call it on the thread that parses
+//returns 0 (and zeroed stats) when they were compiled out
+uint8_t ozterm_get_stats(Ozterm* terminal, OztermStats* stats);
+void ozterm_reset_stats(Ozterm* terminal);
+
 //this will cause a OztermWriteToMaster
 void ozterm_send_key(Ozterm* terminal, OztermKeyModifier modifier, uint8_t character);
 
+//typed text (UTF-8) as is, with one OztermWriteToMaster per chunk rather than per byte
+void ozterm_send_text(Ozterm* terminal, const uint8_t* text, int32_t size);
+
+//clipboard contents: line breaks are sent as Enter and, when the application enabled
+//bracketed paste (mode 2004), the text is wrapped in CSI 200~ and CSI 201~
+void ozterm_send_paste(Ozterm* terminal, const uint8_t* text, int32_t size);
+
 //give the data from master to the terminal
 void ozterm_have_read_from_master(Ozterm* terminal, const uint8_t* data, int32_t size);
 
+//same, but stops after max_bytes or once max_microseconds have passed (0 means no limit)
+//returns how many bytes were consumed, give the rest in a later call
+//parser state is kept, so stopping inside an escape sequence is fine
+int32_t ozterm_have_read_from_master_budget(Ozterm* terminal, const uint8_t* data, int32_t size, int32_t max_bytes, uint32_t max_microseconds);
+
+//Fast-forward for output floods: render callbacks are not called and damage is not
+//tracked while enabled, turning it off reports a full refresh of the final state.
+//Replies to the master are still written.
+void ozterm_set_fast_forward(Ozterm* terminal, uint8_t enabled);
+uint8_t ozterm_get_fast_forward(Ozterm* terminal);
+
+//Synchronized output (DEC private mode 2026) is set by the application around a redraw.
+//While it is on, render callbacks are held and ozterm_publish_snapshot() publishes nothing;
+//ending it reports one refresh. Left on for too long, it ends by itself on the next
+//parse or publish, so hosts should keep calling one of them while this returns 1.
+uint8_t ozterm_get_synchronized_output(Ozterm* terminal);
+
+//Frame snapshots let one thread parse while another renders.
+//The parser thread publishes, the render thread acquires; neither blocks the other.
+void ozterm_enable_snapshots(Ozterm* terminal);
+void ozterm_publish_snapshot(Ozterm* terminal);
+//returns NULL if nothing was published since the last acquire,
+//the returned snapshot stays valid until the next acquire
+const OztermSnapshot* ozterm_acquire_snapshot(Ozterm* terminal);
+//snapshots are numbered from 1 as they are published; the first call is for the parser thread
+//and returns the number of the last one published, so the next one is that plus one
+uint32_t ozterm_get_snapshot_sequence(Ozterm* terminal);
+uint32_t ozterm_snapshot_get_sequence(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_row_count(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_column_count(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_cursor_row(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_cursor_column(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_scroll(const OztermSnapshot* snapshot);
+int16_t ozterm_snapshot_get_scroll_count(const OztermSnapshot* snapshot);
+const OztermCell* ozterm_snapshot_get_row_data(const OztermSnapshot* snapshot, int16_t row);
+void ozterm_snapshot_get_default_color(const OztermSnapshot* snapshot, OztermColor* fg, OztermColor* bg);
+//damage since the previously acquired snapshot: blit the scroll delta first, then redraw dirty rows
+uint8_t ozterm_snapshot_is_row_dirty(const OztermSnapshot* snapshot, int16_t row);
+int16_t ozterm_snapshot_get_scroll_delta(const OztermSnapshot* snapshot, int16_t* top, int16_t* bottom);
+//for hosts keeping their own dirty rows: dirty rows in top..bottom move with their content and
+//exposed rows become dirty. pending is the scroll not yet blitted in the same region, the new one
+//is returned; it is 0 when nothing survives and the whole region was marked dirty instead
+int16_t ozterm_shift_dirty_rows(uint8_t* rows, int16_t top, int16_t bottom, int16_t pending, int16_t lines);
+
 #endif // OZTERM_H
@@ -0,0 +1,87 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "palette.h"
+
+_Atomic uint32_t g_palette[PALETTE_SIZE];
+
+static const uint8_t g_ansi_colors[16][3] = {
+    {0, 0, 0},       // Black
+    {205, 0, 0},     // Red
+    {0, 205, 0},     // Green
+    {205, 205, 0},   // Yellow
+    {0, 0, 238},     // Blue
+    {205, 0, 205},   // Magenta
+    {0, 205, 205},   // Cyan
+    {229, 229, 229}, // White (light gray)
+
+    {127, 127, 127}, // Bright Black (dark gray)
+    {255, 0, 0},     // Bright Red
+    {0, 255, 0},     // Bright Green
+    {255, 255, 0},   // Bright Yellow
+    {92, 92, 255},   // Bright Blue
+    {255, 0, 255},   // Bright Magenta
+    {0, 255, 255},   // Bright Cyan
+    {255, 255, 255}  // Bright White
+};
+
+void palette_init()
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        g_palette[i] = PALETTE_RGBA(g_ansi_colors[i][0], g_ansi_colors[i][1], g_ansi_colors[i][2]);
+    }
+
+    // 6x6x6 cube, each step is 51 (0x33) to cover 0-255
+    for (int i = 16; i < 232; ++i)
+    {
+        int ci = i - 16;
+        int red   = ci / 36;
+        int green = (ci / 6) % 6;
+        int blue  = ci % 6;
+        g_palette[i] = PALETTE_RGBA(red * 51, green * 51, blue * 51);
+    }
+
+    // gray ramp, 24 steps from 8 to 238
+    for (int i = 232; i < 256; ++i)
+    {
+        uint8_t level = 8 + (i - 232) * 10;
+        g_palette[i] = PALETTE_RGBA(level, level, level);
+    }
+
+    g_palette[OZTERM_PALETTE_FG] = g_palette[7];
+    g_palette[OZTERM_PALETTE_BG] = g_palette[0];
+}
+
+void palette_set(int index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    if (index >= 0 && index < PALETTE_SIZE)
+    {
+        atomic_store_explicit(&g_palette[index], PALETTE_RGBA(red, green, blue), memory_order_relaxed);
+    }
+}
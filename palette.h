@@ -0,0 +1,70 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "ozterm.h"
+
+// Colors are packed as 0xRRGGBBAA
+#define PALETTE_RGBA(r, g, b) (((uint32_t)(r) << 24) | ((uint32_t)(g) << 16) | ((uint32_t)(b) << 8) | 0xFF)
+#define PALETTE_R(c) ((uint8_t)((c) >> 24))
+#define PALETTE_G(c) ((uint8_t)((c) >> 16))
+#define PALETTE_B(c) ((uint8_t)((c) >> 8))
+
+// The 256 indexed colors, then the default foreground and background at
+// OZTERM_PALETTE_FG and OZTERM_PALETTE_BG, apart so OSC 10/11 leave SGR colors alone.
+// Entries are atomic so the parser thread can change them while rendering.
+#define PALETTE_SIZE 258
+extern _Atomic uint32_t g_palette[PALETTE_SIZE];
+
+//fill g_palette with the xterm defaults: 16 ANSI colors, 6x6x6 cube, gray ramp,
+//default colors of white (7) on black (0)
+void palette_init();
+
+//runtime change of a single entry (OSC 4) or of a default color (OSC 10/11)
+void palette_set(int index, uint8_t red, uint8_t green, uint8_t blue);
+
+static inline uint32_t palette_resolve(const OztermColor* color)
+{
+    if (color->use_rgb)
+        return PALETTE_RGBA(color->red, color->green, color->blue);
+
+    if (color->use_default)
+    {
+        int index = color->use_default == OZTERM_COLOR_DEFAULT_FG ? OZTERM_PALETTE_FG : OZTERM_PALETTE_BG;
+        return atomic_load_explicit(&g_palette[index], memory_order_relaxed);
+    }
+
+    return atomic_load_explicit(&g_palette[color->index], memory_order_relaxed);
+}
+
+#endif // PALETTE_H
@@ -0,0 +1,262 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+typedef struct PoolJob
+{
+    PoolTask task;
+    void* data;
+} PoolJob;
+
+// Growable circular deque. Locked, but each lock is almost only taken by its
+// owner, thieves only come when they ran out of work themselves.
+typedef struct PoolDeque
+{
+    pthread_mutex_t lock;
+    PoolJob* jobs;
+    int capacity;
+    int head;
+    int count;
+} PoolDeque;
+
+typedef struct PoolWorker
+{
+    Pool* pool;
+    int index;
+    pthread_t thread;
+    PoolDeque deque;
+} PoolWorker;
+
+struct Pool
+{
+    PoolWorker* workers;
+    int worker_count;
+    atomic_uint next_worker;
+    atomic_int pending;
+    int quit;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+static int deque_push_back(PoolDeque* deque, PoolJob job)
+{
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count == deque->capacity)
+    {
+        int capacity = deque->capacity * 2;
+        PoolJob* jobs = malloc(sizeof(PoolJob) * capacity);
+        if (!jobs)
+        {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+
+        for (int i = 0; i < deque->count; ++i)
+            jobs[i] = deque->jobs[(deque->head + i) % deque->capacity];
+
+        free(deque->jobs);
+        deque->jobs = jobs;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+
+    deque->jobs[(deque->head + deque->count) % deque->capacity] = job;
+    deque->count++;
+
+    pthread_mutex_unlock(&deque->lock);
+    return 1;
+}
+
+static int deque_pop_front(PoolDeque* deque, PoolJob* job)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0)
+    {
+        *job = deque->jobs[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+// Thieves take the newest task, the owner keeps going through the oldest
+static int deque_pop_back(PoolDeque* deque, PoolJob* job)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0)
+    {
+        deque->count--;
+        *job = deque->jobs[(deque->head + deque->count) % deque->capacity];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+static int pool_find_job(PoolWorker* worker, PoolJob* job)
+{
+    Pool* pool = worker->pool;
+
+    if (deque_pop_front(&worker->deque, job))
+        return 1;
+
+    for (int i = 1; i < pool->worker_count; ++i)
+    {
+        PoolWorker* victim = &pool->workers[(worker->index + i) % pool->worker_count];
+        if (deque_pop_back(&victim->deque, job))
+            return 1;
+    }
+
+    return 0;
+}
+
+static void* pool_worker_main(void* data)
+{
+    PoolWorker* worker = data;
+    Pool* pool = worker->pool;
+
+    for (;;)
+    {
+        PoolJob job;
+
+        if (pool_find_job(worker, &job))
+        {
+            atomic_fetch_sub(&pool->pending, 1);
+            job.task(job.data);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->pending) == 0 && !pool->quit)
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        int quit = pool->quit && atomic_load(&pool->pending) == 0;
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        if (quit)
+            break;
+    }
+
+    return NULL;
+}
+
+Pool* pool_create(int worker_count)
+{
+    if (worker_count <= 0)
+        return NULL;
+
+    Pool* pool = calloc(1, sizeof(Pool));
+    pool->workers = calloc(worker_count, sizeof(PoolWorker));
+    pool->worker_count = worker_count;
+    atomic_init(&pool->next_worker, 0);
+    atomic_init(&pool->pending, 0);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    for (int i = 0; i < worker_count; ++i)
+    {
+        PoolWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        worker->deque.jobs = malloc(sizeof(PoolJob) * DEQUE_INITIAL_CAPACITY);
+        worker->deque.capacity = DEQUE_INITIAL_CAPACITY;
+    }
+
+    // Started only once every deque exists, workers steal from all of them
+    for (int i = 0; i < worker_count; ++i)
+    {
+        pthread_create(&pool->workers[i].thread, NULL, pool_worker_main, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+void pool_destroy(Pool* pool)
+{
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (int i = 0; i < pool->worker_count; ++i)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < pool->worker_count; ++i)
+    {
+        pthread_mutex_destroy(&pool->workers[i].deque.lock);
+        free(pool->workers[i].deque.jobs);
+    }
+
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_mutex_destroy(&pool->idle_lock);
+    free(pool->workers);
+    free(pool);
+}
+
+void pool_submit(Pool* pool, PoolTask task, void* data)
+{
+    PoolJob job = { .task = task, .data = data };
+    unsigned index = atomic_fetch_add(&pool->next_worker, 1) % pool->worker_count;
+
+    // Counted first so it never drops below the number of queued jobs
+    atomic_fetch_add(&pool->pending, 1);
+
+    if (!deque_push_back(&pool->workers[index].deque, job))
+    {
+        // Out of memory, run it here rather than lose it
+        atomic_fetch_sub(&pool->pending, 1);
+        task(data);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
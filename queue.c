@@ -0,0 +1,121 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "queue.h"
+
+int queue_init(Queue* queue, uint32_t capacity)
+{
+    queue->data = malloc(capacity);
+    if (!queue->data)
+        return 0;
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->size = 0;
+
+    return 1;
+}
+
+void queue_destroy(Queue* queue)
+{
+    free(queue->data);
+    queue->data = NULL;
+    queue->capacity = 0;
+    queue->size = 0;
+}
+
+static int queue_grow(Queue* queue, uint32_t needed)
+{
+    uint32_t capacity = queue->capacity;
+    while (capacity < needed)
+    {
+        if (capacity > UINT32_MAX / 2)
+            return 0;
+        capacity *= 2;
+    }
+
+    uint8_t* data = malloc(capacity);
+    if (!data)
+        return 0;
+
+    //unwrap into the new storage
+    uint32_t first = queue->capacity - queue->head;
+    if (first > queue->size)
+        first = queue->size;
+    memcpy(data, queue->data + queue->head, first);
+    memcpy(data + first, queue->data, queue->size - first);
+
+    free(queue->data);
+    queue->data = data;
+    queue->capacity = capacity;
+    queue->head = 0;
+
+    return 1;
+}
+
+int queue_push(Queue* queue, const uint8_t* data, uint32_t size)
+{
+    if (size > UINT32_MAX - queue->size)
+        return 0;
+
+    if (queue->size + size > queue->capacity && !queue_grow(queue, queue->size + size))
+        return 0;
+
+    uint32_t tail = (queue->head + queue->size) % queue->capacity;
+    uint32_t first = queue->capacity - tail;
+    if (first > size)
+        first = size;
+
+    memcpy(queue->data + tail, data, first);
+    memcpy(queue->data, data + first, size - first);
+    queue->size += size;
+
+    return 1;
+}
+
+uint32_t queue_peek(Queue* queue, const uint8_t** span)
+{
+    uint32_t until_end = queue->capacity - queue->head;
+
+    *span = queue->data + queue->head;
+
+    return queue->size < until_end ? queue->size : until_end;
+}
+
+void queue_pop(Queue* queue, uint32_t size)
+{
+    queue->head = (queue->head + size) % queue->capacity;
+    queue->size -= size;
+
+    if (queue->size == 0)
+        queue->head = 0;
+}
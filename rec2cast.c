@@ -0,0 +1,207 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// Converts a session recording (see recorder.h) to asciicast v2 for asciinema.
+//
+//   ozterm-rec2cast recording.rec > session.cast
+//
+// Output becomes "o" events and sent input "i" events. Bytes that are not valid
+// UTF-8 are replaced by U+FFFD like asciinema does, a character split between two
+// records is carried over to the next record in the same direction.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ozterm.h"
+#include "recorder.h"
+
+typedef struct Carry
+{
+    uint8_t bytes[4];
+    int length;
+} Carry;
+
+//length of the UTF-8 sequence starting with c, 0 if c cannot start one
+static int utf8_length(uint8_t c)
+{
+    if (c < 0x80) return 1;
+    if (c >= 0xC2 && c <= 0xDF) return 2;
+    if (c >= 0xE0 && c <= 0xEF) return 3;
+    if (c >= 0xF0 && c <= 0xF4) return 4;
+    return 0;
+}
+
+static int utf8_valid(const uint8_t* s, int length)
+{
+    for (int i = 1; i < length; ++i)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+            return 0;
+    }
+
+    //overlong forms, surrogates and past U+10FFFF
+    if (length == 3 && s[0] == 0xE0 && s[1] < 0xA0) return 0;
+    if (length == 3 && s[0] == 0xED && s[1] > 0x9F) return 0;
+    if (length == 4 && s[0] == 0xF0 && s[1] < 0x90) return 0;
+    if (length == 4 && s[0] == 0xF4 && s[1] > 0x8F) return 0;
+    return 1;
+}
+
+static void write_json_string(const uint8_t* data, int size, Carry* carry)
+{
+    putchar('"');
+
+    //the carried bytes go first, joined with the start of this record
+    uint8_t joined[8];
+    int joined_length = 0;
+    if (carry->length > 0)
+    {
+        memcpy(joined, carry->bytes, carry->length);
+        joined_length = carry->length;
+        int take = utf8_length(joined[0]) - joined_length;
+        if (take > size)
+            take = size;
+        memcpy(joined + joined_length, data, take);
+        joined_length += take;
+        data += take;
+        size -= take;
+        carry->length = 0;
+
+        //a record that does not even finish the character
+        if (joined_length < utf8_length(joined[0]))
+        {
+            memcpy(carry->bytes, joined, joined_length);
+            carry->length = joined_length;
+            joined_length = 0;
+        }
+    }
+
+    for (int part = 0; part < 2; ++part)
+    {
+        const uint8_t* s = part == 0 ? joined : data;
+        int length = part == 0 ? joined_length : size;
+
+        for (int i = 0; i < length; )
+        {
+            uint8_t c = s[i];
+            int sequence = utf8_length(c);
+
+            if (sequence == 1)
+            {
+                if (c == '"' || c == '\\')
+                    printf("\\%c", c);
+                else if (c < 0x20 || c == 0x7F)
+                    printf("\\u%04x", c);
+                else
+                    putchar(c);
+                i++;
+            }
+            else if (sequence > 1 && i + sequence > length && part == 1)
+            {
+                //cut off by the end of the record
+                carry->length = length - i;
+                memcpy(carry->bytes, s + i, carry->length);
+                break;
+            }
+            else if (sequence > 1 && i + sequence <= length && utf8_valid(s + i, sequence))
+            {
+                fwrite(s + i, 1, sequence, stdout);
+                i += sequence;
+            }
+            else
+            {
+                printf("\\ufffd");
+                i++;
+            }
+        }
+    }
+
+    putchar('"');
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s recording.rec > session.cast\n", argv[0]);
+        return 1;
+    }
+
+    size_t size;
+    uint8_t* data = recorder_load_file(argv[1], &size);
+    if (!data)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (!recorder_is_recording(data, size))
+    {
+        fprintf(stderr, "%s: not a recording\n", argv[1]);
+        free(data);
+        return 1;
+    }
+
+    int rows = data[8] | data[9] << 8;
+    int columns = data[10] | data[11] << 8;
+    uint64_t start = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        start = start << 8 | data[16 + i];
+    }
+
+    printf("{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %llu}\n",
+           columns, rows, (unsigned long long)(start / 1000000));
+
+    uint64_t time = 0;
+    Carry carry[2];
+    memset(carry, 0, sizeof(carry));
+
+    const uint8_t* cursor = data + RECORDER_HEADER_SIZE;
+    const uint8_t* end = data + size;
+    RecorderRecord record;
+    int result;
+    while ((result = recorder_next_record(&cursor, end, &record)) > 0 && record.size <= INT32_MAX)
+    {
+        time += record.delay;
+        uint8_t input = record.direction == OZTERM_RECORD_INPUT;
+
+        printf("[%llu.%06llu, \"%s\", ", (unsigned long long)(time / 1000000),
+               (unsigned long long)(time % 1000000), input ? "i" : "o");
+        write_json_string(record.data, (int)record.size, &carry[input]);
+        printf("]\n");
+    }
+
+    if (result != 0)
+        fprintf(stderr, "%s: truncated record\n", argv[1]);
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "recorder.h"
+#include "queue.h"
+
+#define RECORDER_QUEUE_SIZE (64 * 1024)
+
+// The writer is woken once this much is pending, or after the interval otherwise
+#define RECORDER_FLUSH_SIZE (256 * 1024)
+#define RECORDER_FLUSH_INTERVAL_MS 250
+
+// Past this, records are dropped instead of growing memory without bound
+#define RECORDER_MAX_PENDING (64 * 1024 * 1024)
+
+struct Recorder
+{
+    FILE* file;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    Queue pending;
+    Queue writing;
+    uint64_t last_time;
+    uint64_t dropped;
+    int stop;
+};
+
+static uint64_t recorder_now_microseconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put_u64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        out[i] = (value >> (i * 8)) & 0xFF;
+    }
+}
+
+static int put_varint(uint8_t* out, uint64_t value)
+{
+    int length = 0;
+    while (value >= 0x80)
+    {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+static void* recorder_thread(void* data)
+{
+    Recorder* recorder = data;
+
+    pthread_mutex_lock(&recorder->lock);
+    for (;;)
+    {
+        while (!recorder->stop && recorder->pending.size < RECORDER_FLUSH_SIZE)
+        {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += RECORDER_FLUSH_INTERVAL_MS * 1000000L;
+            until.tv_sec += until.tv_nsec / 1000000000L;
+            until.tv_nsec %= 1000000000L;
+
+            if (pthread_cond_timedwait(&recorder->wake, &recorder->lock, &until) != 0 && recorder->pending.size > 0)
+                break;
+        }
+
+        //swap, so writers keep appending while this one is on the disk
+        Queue swap = recorder->pending;
+        recorder->pending = recorder->writing;
+        recorder->writing = swap;
+        int stop = recorder->stop;
+        pthread_mutex_unlock(&recorder->lock);
+
+        const uint8_t* span;
+        uint32_t length;
+        while ((length = queue_peek(&recorder->writing, &span)) > 0)
+        {
+            fwrite(span, 1, length, recorder->file);
+            queue_pop(&recorder->writing, length);
+        }
+        fflush(recorder->file);
+
+        pthread_mutex_lock(&recorder->lock);
+        if (stop && recorder->pending.size == 0)
+            break;
+    }
+    pthread_mutex_unlock(&recorder->lock);
+
+    return NULL;
+}
+
+Recorder* recorder_open(const char* path, uint16_t rows, uint16_t columns)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return NULL;
+
+    Recorder* recorder = malloc(sizeof(Recorder));
+    memset(recorder, 0, sizeof(Recorder));
+    recorder->file = file;
+    queue_init(&recorder->pending, RECORDER_QUEUE_SIZE);
+    queue_init(&recorder->writing, RECORDER_QUEUE_SIZE);
+    pthread_mutex_init(&recorder->lock, NULL);
+    pthread_cond_init(&recorder->wake, NULL);
+    recorder->last_time = recorder_now_microseconds(CLOCK_MONOTONIC);
+
+    uint8_t header[RECORDER_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, RECORDER_MAGIC, 8);
+    put_u16(header + 8, rows);
+    put_u16(header + 10, columns);
+    put_u64(header + 16, recorder_now_microseconds(CLOCK_REALTIME));
+    fwrite(header, 1, sizeof(header), file);
+
+    pthread_create(&recorder->thread, NULL, recorder_thread, recorder);
+
+    return recorder;
+}
+
+void recorder_write(Recorder* recorder, uint8_t direction, const uint8_t* data, int32_t size)
+{
+    if (size <= 0)
+        return;
+
+    uint64_t now = recorder_now_microseconds(CLOCK_MONOTONIC);
+
+    uint8_t head[24];
+    int head_length = 0;
+
+    pthread_mutex_lock(&recorder->lock);
+
+    if (recorder->pending.size + (uint64_t)size > RECORDER_MAX_PENDING)
+    {
+        recorder->dropped++;
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    //writers on other threads may have taken their time after this one
+    uint64_t delay = now > recorder->last_time ? now - recorder->last_time : 0;
+    recorder->last_time += delay;
+
+    head_length += put_varint(head, delay);
+    head[head_length++] = direction;
+    head_length += put_varint(head + head_length, (uint64_t)size);
+
+    if (queue_push(&recorder->pending, head, head_length) == 0)
+    {
+        recorder->dropped++;
+    }
+    else if (queue_push(&recorder->pending, data, size) == 0)
+    {
+        //take the head back off the tail, a record is written whole or not at all
+        recorder->pending.size -= head_length;
+        recorder->dropped++;
+    }
+
+    if (recorder->pending.size >= RECORDER_FLUSH_SIZE)
+    {
+        pthread_cond_signal(&recorder->wake);
+    }
+
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+uint64_t recorder_close(Recorder* recorder)
+{
+    pthread_mutex_lock(&recorder->lock);
+    recorder->stop = 1;
+    pthread_cond_signal(&recorder->wake);
+    pthread_mutex_unlock(&recorder->lock);
+
+    pthread_join(recorder->thread, NULL);
+
+    uint64_t dropped = recorder->dropped;
+
+    fclose(recorder->file);
+    pthread_mutex_destroy(&recorder->lock);
+    pthread_cond_destroy(&recorder->wake);
+    queue_destroy(&recorder->pending);
+    queue_destroy(&recorder->writing);
+    free(recorder);
+
+    return dropped;
+}
+
+uint8_t* recorder_load_file(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    size_t capacity = 1 << 20;
+    uint8_t* data = malloc(capacity);
+    *size = 0;
+
+    while (data)
+    {
+        size_t length = fread(data + *size, 1, capacity - *size, file);
+        *size += length;
+        if (length == 0)
+            break;
+
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            uint8_t* grown = realloc(data, capacity);
+            if (!grown)
+                free(data);
+            data = grown;
+        }
+    }
+
+    int error = data ? (ferror(file) ? EIO : 0) : ENOMEM;
+    fclose(file);
+
+    if (error != 0)
+    {
+        free(data);
+        errno = error;
+        return NULL;
+    }
+
+    return data;
+}
+
+int recorder_is_recording(const uint8_t* data, size_t size)
+{
+    return size >= RECORDER_HEADER_SIZE && memcmp(data, RECORDER_MAGIC, 8) == 0;
+}
+
+static int get_varint(const uint8_t** cursor, const uint8_t* end, uint64_t* value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *cursor < end; shift += 7)
+    {
+        uint8_t c = *(*cursor)++;
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+int recorder_next_record(const uint8_t** cursor, const uint8_t* end, RecorderRecord* record)
+{
+    if (*cursor >= end)
+        return 0;
+
+    if (!get_varint(cursor, end, &record->delay) || *cursor >= end)
+        return -1;
+
+    record->direction = *(*cursor)++;
+    if (!get_varint(cursor, end, &record->size) || record->size > (uint64_t)(end - *cursor))
+        return -1;
+
+    record->data = *cursor;
+    *cursor += record->size;
+    return 1;
+}
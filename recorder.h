@@ -0,0 +1,76 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Session recording: what a terminal read from master and what was sent to it,
+// with timestamps. Records are appended to memory and written to the file by a
+// background thread, so recording never waits for the disk.
+//
+// File format, integers little endian:
+//   header   "OZTREC" 0x01 0x00, rows u16, columns u16, reserved u32, start u64 (unix microseconds)
+//   record   delay varint (microseconds since the previous record), direction u8, size varint, bytes
+// direction is OZTERM_RECORD_OUTPUT or OZTERM_RECORD_INPUT. rec2cast turns a file into asciicast v2.
+typedef struct Recorder Recorder;
+
+#define RECORDER_MAGIC "OZTREC\x01"
+#define RECORDER_HEADER_SIZE 24
+
+//NULL if the file cannot be created
+Recorder* recorder_open(const char* path, uint16_t rows, uint16_t columns);
+
+//thread safe, matches OztermRecord so it can be called straight from that callback
+void recorder_write(Recorder* recorder, uint8_t direction, const uint8_t* data, int32_t size);
+
+//writes what is left and closes the file, returns the records dropped because the disk fell behind
+uint64_t recorder_close(Recorder* recorder);
+
+// Reading a recording back, from a file loaded whole into memory
+typedef struct RecorderRecord
+{
+    uint64_t delay;
+    uint8_t direction;
+    const uint8_t* data;
+    uint64_t size;
+} RecorderRecord;
+
+//any file, not only recordings; NULL with errno set if it cannot be read, free() the result
+uint8_t* recorder_load_file(const char* path, size_t* size);
+
+//1 if data starts with a recording header, the records follow at data + RECORDER_HEADER_SIZE
+int recorder_is_recording(const uint8_t* data, size_t size);
+
+//1 and the record at *cursor, which is moved past it; 0 at end, -1 if end cuts a record short
+int recorder_next_record(const uint8_t** cursor, const uint8_t* end, RecorderRecord* record);
+
+#endif // RECORDER_H
@@ -0,0 +1,57 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Lock-free single-producer/single-consumer byte ring.
+// head and tail run freely and wrap, capacity must be a power of two.
+typedef struct Ring
+{
+    uint8_t* data;
+    uint32_t capacity;
+    _Atomic uint32_t head; // only written by the producer
+    _Atomic uint32_t tail; // only written by the consumer
+} Ring;
+
+int ring_init(Ring* ring, uint32_t capacity);
+void ring_destroy(Ring* ring);
+uint32_t ring_used(Ring* ring);
+
+//producer: contiguous free space to write into, then commit what was written
+uint32_t ring_write_span(Ring* ring, uint8_t** span);
+void ring_commit(Ring* ring, uint32_t size);
+
+//consumer: contiguous readable bytes, then consume what was processed
+uint32_t ring_read_span(Ring* ring, const uint8_t** span);
+void ring_consume(Ring* ring, uint32_t size);
+
+#endif // RING_H
@@ -0,0 +1,340 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+// Parser checks without SDL: feed escape sequences and look at the grid.
+// Run with make test; prints the failed checks and exits non-zero if any.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ozterm.h"
+
+#define ROWS 6
+#define COLUMNS 10
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+static void feed(Ozterm* terminal, const char* text)
+{
+    ozterm_have_read_from_master(terminal, (const uint8_t*)text, (int32_t)strlen(text));
+}
+
+static char character_at(Ozterm* terminal, int16_t row, int16_t column)
+{
+    return (char)ozterm_get_row_data(terminal, row)[column].character;
+}
+
+// One letter per row, A on the first
+static void fill_rows(Ozterm* terminal)
+{
+    char text[16];
+    for (int row = 0; row < ROWS; ++row)
+    {
+        snprintf(text, sizeof(text), "\033[%d;1H%c", row + 1, 'A' + row);
+        feed(terminal, text);
+    }
+}
+
+// CSI ... $ r is DECCARA, which is not supported; it must not act as DECSTBM
+static void test_intermediate_not_dispatched_as_plain()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+    fill_rows(terminal);
+
+    feed(terminal, "\033[2;4r");
+    feed(terminal, "\033[3;5H");
+    feed(terminal, "\033[1;1;5;5;1$r");
+
+    // The cursor stays put
+    CHECK(ozterm_get_cursor_row(terminal) == 2);
+    CHECK(ozterm_get_cursor_column(terminal) == 4);
+
+    // The margins are still 2..4: a line feed on row 4 scrolls only them
+    feed(terminal, "\033[4;1H\n");
+    CHECK(character_at(terminal, 0, 0) == 'A');
+    CHECK(character_at(terminal, 1, 0) == 'C');
+    CHECK(character_at(terminal, 2, 0) == 'D');
+    CHECK(character_at(terminal, 4, 0) == 'E');
+    CHECK(ozterm_get_cursor_row(terminal) == 3);
+
+    ozterm_destroy(terminal);
+}
+
+// CSI n SP @ (SL) and CSI n SP A (SR) are not ICH and CUU
+static void test_space_intermediate_ignored()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+    fill_rows(terminal);
+
+    feed(terminal, "\033[3;1H\033[2 @");
+    CHECK(character_at(terminal, 2, 0) == 'C');
+
+    feed(terminal, "\033[2 A");
+    CHECK(ozterm_get_cursor_row(terminal) == 2);
+
+    ozterm_destroy(terminal);
+}
+
+// OSC 10/11 retint only cells in the default colors, so those must be told apart
+// from the palette entries the defaults fall back to
+static void test_default_colors_marked()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+
+    feed(terminal, "a\033[37;40mb\033[39;49mc\033[38;5;7;48;5;0md\033[0me");
+
+    const OztermCell* row = ozterm_get_row_data(terminal, 0);
+    CHECK(row[0].fg_color.use_default == OZTERM_COLOR_DEFAULT_FG);
+    CHECK(row[0].bg_color.use_default == OZTERM_COLOR_DEFAULT_BG);
+    CHECK(row[1].fg_color.use_default == 0 && row[1].fg_color.index == 7);
+    CHECK(row[1].bg_color.use_default == 0 && row[1].bg_color.index == 0);
+    CHECK(row[2].fg_color.use_default == OZTERM_COLOR_DEFAULT_FG);
+    CHECK(row[2].bg_color.use_default == OZTERM_COLOR_DEFAULT_BG);
+    CHECK(row[3].fg_color.use_default == 0 && row[3].bg_color.use_default == 0);
+    CHECK(row[4].fg_color.use_default == OZTERM_COLOR_DEFAULT_FG);
+
+    ozterm_destroy(terminal);
+}
+
+static uint8_t g_palette_rgb[3];
+static int16_t g_palette_index = -1;
+
+static void record_palette(Ozterm* terminal, int16_t index, uint8_t red, uint8_t green, uint8_t blue)
+{
+    g_palette_index = index;
+    g_palette_rgb[0] = red;
+    g_palette_rgb[1] = green;
+    g_palette_rgb[2] = blue;
+}
+
+// OSC 4 with rgb: components of 1 to 4 hex digits, scaled like xterm
+static int set_color(Ozterm* terminal, const char* spec)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "\033]4;1;%s\033\\", spec);
+
+    g_palette_index = -1;
+    feed(terminal, text);
+    return g_palette_index == 1;
+}
+
+static void test_color_spec_digits()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+    ozterm_set_palette_callback(terminal, record_palette);
+
+    CHECK(set_color(terminal, "rgb:8/f/0"));
+    CHECK(g_palette_rgb[0] == 0x88 && g_palette_rgb[1] == 0xff && g_palette_rgb[2] == 0x00);
+
+    CHECK(set_color(terminal, "rgb:80/ff/7f"));
+    CHECK(g_palette_rgb[0] == 0x80 && g_palette_rgb[1] == 0xff && g_palette_rgb[2] == 0x7f);
+
+    CHECK(set_color(terminal, "rgb:abc/fff/000"));
+    CHECK(g_palette_rgb[0] == 0xab && g_palette_rgb[1] == 0xff && g_palette_rgb[2] == 0x00);
+
+    CHECK(set_color(terminal, "rgb:8000/12ff/ffff"));
+    CHECK(g_palette_rgb[0] == 0x80 && g_palette_rgb[1] == 0x12 && g_palette_rgb[2] == 0xff);
+
+    CHECK(!set_color(terminal, "rgb:12345/0/0"));
+
+    ozterm_destroy(terminal);
+}
+
+static OztermUnhandled g_unhandled[8];
+static int32_t g_unhandled_count = 0;
+
+static void record_unhandled(Ozterm* terminal, const OztermUnhandled* sequences, int32_t count, uint32_t others)
+{
+    g_unhandled_count = count < 8 ? count : 8;
+    memcpy(g_unhandled, sequences, g_unhandled_count * sizeof(OztermUnhandled));
+}
+
+// CSI $ r and CSI r are different sequences and reported apart
+static void test_unhandled_keyed_by_intermediate()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+    ozterm_set_unhandled_callback(terminal, record_unhandled, 1000000);
+
+    feed(terminal, "\033[1;1;5;5;1$r\033[1;1;5;5;1$r\033[1 r");
+    ozterm_report_unhandled(terminal);
+
+    CHECK(g_unhandled_count == 2);
+    CHECK(g_unhandled[0].intermediate == '$' && g_unhandled[0].final_byte == 'r' && g_unhandled[0].count == 2);
+    CHECK(g_unhandled[1].intermediate == ' ' && g_unhandled[1].final_byte == 'r' && g_unhandled[1].count == 1);
+
+    ozterm_destroy(terminal);
+}
+
+static int g_scroll_calls = 0;
+static int g_refresh_calls = 0;
+
+static void count_scroll(Ozterm* terminal, int16_t top, int16_t bottom, int16_t lines)
+{
+    g_scroll_calls++;
+}
+
+static void count_refresh(Ozterm* terminal)
+{
+    g_refresh_calls++;
+}
+
+// No scroll reaches the host in the middle of a synchronized update, the end reports one refresh
+static void test_scroll_held_during_synchronized_output()
+{
+    Ozterm* terminal = ozterm_create(ROWS, COLUMNS);
+    ozterm_set_render_callbacks(terminal, count_refresh, NULL, NULL);
+    ozterm_set_scroll_callback(terminal, count_scroll);
+
+    feed(terminal, "\033[6;1H\n\n\n");
+    CHECK(g_scroll_calls == 3);
+
+    g_scroll_calls = 0;
+    g_refresh_calls = 0;
+    feed(terminal, "\033[?2026h");
+    feed(terminal, "\033[2;5r\033[5;1H\n\033M\033[2S\033[T\033[3;1H\033[L\033[M");
+    ozterm_scroll(terminal, 2);
+    ozterm_scroll(terminal, 0);
+    CHECK(g_scroll_calls == 0);
+    CHECK(g_refresh_calls == 0);
+
+    feed(terminal, "\033[?2026l");
+    CHECK(g_scroll_calls == 0);
+    CHECK(g_refresh_calls == 1);
+
+    ozterm_destroy(terminal);
+}
+
+#define PUBLISH_COUNT 20000
+#define PUBLISH_ROWS 1000
+
+static atomic_int g_publishing_done;
+
+// Scrolls one new line in per snapshot, the renderer sees most of them skipped or taken mid-publish
+static void* publish_scrolls(void* argument)
+{
+    Ozterm* terminal = argument;
+    char text[32];
+    for (int i = 0; i < PUBLISH_COUNT; ++i)
+    {
+        snprintf(text, sizeof(text), "\r\n%c%d", 'a' + i % 26, i);
+        feed(terminal, text);
+        ozterm_publish_snapshot(terminal);
+    }
+    atomic_store(&g_publishing_done, 1);
+    return NULL;
+}
+
+// A renderer keeping its own grid must end up with the snapshot contents after every acquire
+static void test_snapshot_damage_applied_once()
+{
+    Ozterm* terminal = ozterm_create(PUBLISH_ROWS, COLUMNS);
+    ozterm_enable_snapshots(terminal);
+
+    // Every row differs, so a shift applied twice shows up in rows that are not redrawn
+    char text[32];
+    for (int row = 0; row < PUBLISH_ROWS; ++row)
+    {
+        snprintf(text, sizeof(text), "\033[%d;1H%d", row + 1, row);
+        feed(terminal, text);
+    }
+
+    static OztermCell shadow[PUBLISH_ROWS][COLUMNS];
+    ozterm_publish_snapshot(terminal);
+    const OztermSnapshot* first = ozterm_acquire_snapshot(terminal);
+    for (int16_t row = 0; row < PUBLISH_ROWS; ++row)
+        memcpy(shadow[row], ozterm_snapshot_get_row_data(first, row), sizeof(shadow[row]));
+
+    int mismatches = 0;
+
+    pthread_t thread;
+    atomic_store(&g_publishing_done, 0);
+    pthread_create(&thread, NULL, publish_scrolls, terminal);
+
+    for (int done = 0; !done;)
+    {
+        done = atomic_load(&g_publishing_done);
+
+        const OztermSnapshot* snapshot = ozterm_acquire_snapshot(terminal);
+        if (!snapshot)
+            continue;
+
+        int16_t top, bottom;
+        int16_t lines = ozterm_snapshot_get_scroll_delta(snapshot, &top, &bottom);
+        if (lines > 0)
+            memmove(shadow[top], shadow[top + lines], sizeof(shadow[0]) * (bottom - top + 1 - lines));
+        else if (lines < 0)
+            memmove(shadow[top - lines], shadow[top], sizeof(shadow[0]) * (bottom - top + 1 + lines));
+
+        for (int16_t row = 0; row < PUBLISH_ROWS; ++row)
+        {
+            const OztermCell* data = ozterm_snapshot_get_row_data(snapshot, row);
+            if (ozterm_snapshot_is_row_dirty(snapshot, row))
+                memcpy(shadow[row], data, sizeof(shadow[row]));
+            else if (memcmp(shadow[row], data, sizeof(shadow[row])) != 0)
+                mismatches++;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    CHECK(mismatches == 0);
+
+    ozterm_destroy(terminal);
+}
+
+int main()
+{
+    test_intermediate_not_dispatched_as_plain();
+    test_space_intermediate_ignored();
+    test_default_colors_marked();
+    test_color_spec_digits();
+    test_unhandled_keyed_by_intermediate();
+    test_scroll_held_during_synchronized_output();
+    test_snapshot_damage_applied_once();
+
+    if (g_failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uring.h"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define URING_AVAILABLE 1
+#endif
+#endif
+
+#ifdef URING_AVAILABLE
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct Uring
+{
+    int fd;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned sq_pending; // prepared, not yet handed to the kernel
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    uint64_t enter_count;
+};
+
+static int uring_enter(Uring* uring, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    uring->enter_count++;
+    return (int)syscall(__NR_io_uring_enter, uring->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+Uring* uring_create(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return NULL;
+
+    Uring* uring = calloc(1, sizeof(Uring));
+    uring->fd = fd;
+
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // Newer kernels map both rings at once
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (uring->cq_ring_size > uring->sq_ring_size)
+            uring->sq_ring_size = uring->cq_ring_size;
+        uring->cq_ring_size = uring->sq_ring_size;
+    }
+
+    uring->sq_ring = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        uring->cq_ring = uring->sq_ring;
+    }
+    else
+    {
+        uring->cq_ring = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (uring->sq_ring == MAP_FAILED || uring->cq_ring == MAP_FAILED || uring->sqes == MAP_FAILED)
+    {
+        uring_destroy(uring);
+        return NULL;
+    }
+
+    uint8_t* sq = uring->sq_ring;
+    uring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    uring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    uring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    uring->sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    uring->sq_array = (unsigned*)(sq + params.sq_off.array);
+
+    uint8_t* cq = uring->cq_ring;
+    uring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    uring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    uring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return uring;
+}
+
+void uring_destroy(Uring* uring)
+{
+    if (!uring)
+        return;
+
+    if (uring->sqes && uring->sqes != MAP_FAILED)
+        munmap(uring->sqes, uring->sqes_size);
+    if (uring->cq_ring && uring->cq_ring != MAP_FAILED && uring->cq_ring != uring->sq_ring)
+        munmap(uring->cq_ring, uring->cq_ring_size);
+    if (uring->sq_ring && uring->sq_ring != MAP_FAILED)
+        munmap(uring->sq_ring, uring->sq_ring_size);
+
+    close(uring->fd);
+    free(uring);
+}
+
+int uring_get_fd(Uring* uring)
+{
+    return uring->fd;
+}
+
+int uring_register_buffers(Uring* uring, const struct iovec* buffers, unsigned count)
+{
+    return syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+static struct io_uring_sqe* uring_get_sqe(Uring* uring)
+{
+    unsigned head = __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *uring->sq_tail + uring->sq_pending;
+
+    // Full: hand over what is there to make room
+    if (tail - head >= uring->sq_entries)
+    {
+        uring_submit(uring);
+        tail = *uring->sq_tail;
+    }
+
+    unsigned index = tail & uring->sq_mask;
+    struct io_uring_sqe* sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    uring->sq_array[index] = index;
+    uring->sq_pending++;
+
+    return sqe;
+}
+
+void uring_prepare_read(Uring* uring, int fd, void* buffer, unsigned size, int buffer_index, uint64_t user_data)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(uring);
+
+    sqe->opcode = buffer_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = size;
+    sqe->off = (uint64_t)-1; // current position, the only thing a pty has
+    sqe->buf_index = buffer_index >= 0 ? buffer_index : 0;
+    sqe->user_data = user_data;
+}
+
+void uring_prepare_write(Uring* uring, int fd, const void* data, unsigned size, uint64_t user_data)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(uring);
+
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = size;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = user_data;
+}
+
+void uring_submit(Uring* uring)
+{
+    if (uring->sq_pending == 0)
+        return;
+
+    unsigned count = uring->sq_pending;
+    __atomic_store_n(uring->sq_tail, *uring->sq_tail + count, __ATOMIC_RELEASE);
+    uring->sq_pending = 0;
+
+    while (count > 0)
+    {
+        int submitted = uring_enter(uring, count, 0, 0);
+        if (submitted <= 0)
+            break;
+        count -= submitted;
+    }
+}
+
+unsigned uring_reap(Uring* uring, UringCompletion completion, void* context)
+{
+    unsigned head = *uring->cq_head;
+    unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = tail - head;
+
+    for (; head != tail; ++head)
+    {
+        struct io_uring_cqe* cqe = &uring->cqes[head & uring->cq_mask];
+        completion(context, cqe->user_data, cqe->res);
+    }
+
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+uint64_t uring_get_enter_count(Uring* uring)
+{
+    return uring->enter_count;
+}
+
+#else // !URING_AVAILABLE
+
+Uring* uring_create(unsigned entries)
+{
+    return NULL;
+}
+
+void uring_destroy(Uring* uring)
+{
+}
+
+int uring_get_fd(Uring* uring)
+{
+    return -1;
+}
+
+int uring_register_buffers(Uring* uring, const struct iovec* buffers, unsigned count)
+{
+    return 0;
+}
+
+void uring_prepare_read(Uring* uring, int fd, void* buffer, unsigned size, int buffer_index, uint64_t user_data)
+{
+}
+
+void uring_prepare_write(Uring* uring, int fd, const void* data, unsigned size, uint64_t user_data)
+{
+}
+
+void uring_submit(Uring* uring)
+{
+}
+
+unsigned uring_reap(Uring* uring, UringCompletion completion, void* context)
+{
+    return 0;
+}
+
+uint64_t uring_get_enter_count(Uring* uring)
+{
+    return 0;
+}
+
+#endif // URING_AVAILABLE
@@ -0,0 +1,64 @@
+/*
+ *  BSD 2-Clause License
+ *
+ *  Copyright (c) 2025, ozkl
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ *  list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ *  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ *  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ *  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ *  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Minimal io_uring on raw syscalls, no liburing needed. Where the kernel headers
+// lack io_uring, uring_create() fails and callers fall back to something else.
+typedef struct Uring Uring;
+
+//called by uring_reap() per completion, result is the byte count or -errno
+typedef void (*UringCompletion)(void* context, uint64_t user_data, int32_t result);
+
+//NULL if io_uring is not available
+Uring* uring_create(unsigned entries);
+void uring_destroy(Uring* uring);
+
+//readable while completions are waiting, so it can sit in an epoll set
+int uring_get_fd(Uring* uring);
+
+//fixed buffers skip the page pinning on every read, returns 0 on failure
+int uring_register_buffers(Uring* uring, const struct iovec* buffers, unsigned count);
+
+//queued until uring_submit(), buffer_index < 0 means a plain read
+void uring_prepare_read(Uring* uring, int fd, void* buffer, unsigned size, int buffer_index, uint64_t user_data);
+void uring_prepare_write(Uring* uring, int fd, const void* data, unsigned size, uint64_t user_data);
+
+//one system call for everything prepared since the last submit
+void uring_submit(Uring* uring);
+unsigned uring_reap(Uring* uring, UringCompletion completion, void* context);
+
+//io_uring_enter calls so far
+uint64_t uring_get_enter_count(Uring* uring);
+
+#endif // URING_H